@@ -241,8 +241,6 @@ alloc_scatter(enum Scatter_Kind kind, int id, Expr * expr)
     return sc;
 }
 
-static void free_expr(Expr *);
-
 static void
 free_arg_list(Arg_List * args)
 {
@@ -268,7 +266,7 @@ free_scatter(Scatter * sc)
     }
 }
 
-static void
+void
 free_expr(Expr * expr)
 {
     switch (expr->kind) {
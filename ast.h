@@ -211,6 +211,7 @@ extern char *alloc_string(const char *);
 
 extern void dealloc_node(void *);
 extern void dealloc_string(char *);
+extern void free_expr(Expr *);
 extern void free_stmt(Stmt *);
 
 #if FLOATS_ARE_BOXED
@@ -85,6 +85,9 @@ struct state {
     unsigned saved_stack;
     unsigned num_loops, max_loops;
     Loop *loops;
+    unsigned lineno;		/* Line the next statement will decompile to */
+    unsigned num_line_runs, max_line_runs;
+    Line_Run *line_runs;
     GState *gstate;
 };
 typedef struct state State;
@@ -124,7 +127,7 @@ free_gstate(GState gstate)
 }
 
 static void
-init_state(State * state, GState * gstate)
+init_state(State * state, GState * gstate, unsigned lineno)
 {
     state->num_literals = state->num_forks = state->num_labels = 0;
     state->num_var_refs = state->num_stacks = 0;
@@ -151,6 +154,12 @@ init_state(State * state, GState * gstate)
     state->max_loops = 5;
     state->loops = mymalloc(sizeof(Loop) * state->max_loops, M_CODE_GEN);
 
+    state->lineno = lineno;
+    state->num_line_runs = 0;
+    state->max_line_runs = 10;
+    state->line_runs = mymalloc(sizeof(Line_Run) * state->max_line_runs,
+				M_LINE_RUNS);
+
     state->gstate = gstate;
 }
 
@@ -166,6 +175,95 @@ free_state(State state)
     myfree(state.loops, M_CODE_GEN);
 }
 
+/*********** Line numbers ***********/
+
+/* Tracebacks report line numbers in the program as verb_code() would list
+ * it, which is what find_hot_node() in decompile.c computes.  Rather than
+ * decompiling on every lookup, we record here which line each run of bytes
+ * would be blamed on, counting lines exactly the way find_hot_node() does.
+ */
+
+static unsigned
+stmt_lines(Stmt * stmt)
+{
+    unsigned n = 0;
+
+    for (; stmt; stmt = stmt->next) {
+	switch (stmt->kind) {
+	case STMT_COND:
+	    {
+		Cond_Arm *arm;
+
+		for (arm = stmt->s.cond.arms; arm; arm = arm->next)
+		    n += 1 + stmt_lines(arm->stmt);
+		if (stmt->s.cond.otherwise)
+		    n += 1 + stmt_lines(stmt->s.cond.otherwise);
+	    }
+	    break;
+	case STMT_LIST:
+	    n += 1 + stmt_lines(stmt->s.list.body);
+	    break;
+	case STMT_RANGE:
+	    n += 1 + stmt_lines(stmt->s.range.body);
+	    break;
+	case STMT_WHILE:
+	    n += 1 + stmt_lines(stmt->s.loop.body);
+	    break;
+	case STMT_FORK:
+	    n += 1 + stmt_lines(stmt->s.fork.body);
+	    break;
+	case STMT_TRY_EXCEPT:
+	    {
+		Except_Arm *ex;
+
+		n += 1 + stmt_lines(stmt->s.catch.body);
+		for (ex = stmt->s.catch.excepts; ex; ex = ex->next)
+		    n += 1 + stmt_lines(ex->stmt);
+	    }
+	    break;
+	case STMT_TRY_FINALLY:
+	    n += 2 + stmt_lines(stmt->s.finally.body)
+		+ stmt_lines(stmt->s.finally.handler);
+	    break;
+	default:
+	    break;
+	}
+	n++;			/* the statement's last (or only) line */
+    }
+
+    return n;
+}
+
+/* Blame bytes emitted from here on LINE. */
+static void
+blame_line(unsigned line, State * state)
+{
+    Line_Run *run;
+
+    if (state->num_line_runs > 0) {
+	run = &(state->line_runs[state->num_line_runs - 1]);
+	if (run->pc == state->num_bytes) {
+	    /* Nothing was emitted for the previous run; reuse it. */
+	    if (state->num_line_runs > 1 && run[-1].line == line)
+		state->num_line_runs--;
+	    else
+		run->line = line;
+	    return;
+	}
+	if (run->line == line)
+	    return;
+    }
+    if (state->num_line_runs == state->max_line_runs) {
+	state->max_line_runs *= 2;
+	state->line_runs = myrealloc(state->line_runs,
+				     sizeof(Line_Run) * state->max_line_runs,
+				     M_LINE_RUNS);
+    }
+    run = &(state->line_runs[state->num_line_runs++]);
+    run->pc = state->num_bytes;
+    run->line = line;
+}
+
 static void
 emit_byte(Byte b, State * state)
 {
@@ -933,7 +1031,7 @@ generate_expr(Expr * expr, State * state)
     }
 }
 
-static Bytecodes stmt_to_code(Stmt *, GState *);
+static Bytecodes stmt_to_code(Stmt *, GState *, unsigned);
 
 static void
 generate_stmt(Stmt * stmt, State * state)
@@ -949,19 +1047,23 @@ generate_stmt(Stmt * stmt, State * state)
 		for (arms = stmt->s.cond.arms; arms; arms = arms->next) {
 		    int else_label;
 
+		    blame_line(state->lineno++, state);
 		    generate_expr(arms->condition, state);
 		    emit_byte(if_op, state);
 		    else_label = add_label(state);
 		    pop_stack(1, state);
 		    generate_stmt(arms->stmt, state);
+		    blame_line(state->lineno - 1, state);
 		    emit_byte(OP_JUMP, state);
 		    end_label = add_linked_label(end_label, state);
 		    define_label(else_label, state);
 		    if_op = OP_EIF;
 		}
 
-		if (stmt->s.cond.otherwise)
+		if (stmt->s.cond.otherwise) {
+		    state->lineno++;
 		    generate_stmt(stmt->s.cond.otherwise, state);
+		}
 		define_label(end_label, state);
 	    }
 	    break;
@@ -970,6 +1072,7 @@ generate_stmt(Stmt * stmt, State * state)
 		Fixup loop_top;
 		int end_label;
 
+		blame_line(state->lineno++, state);
 		generate_expr(stmt->s.list.expr, state);
 		emit_byte(OPTIM_NUM_TO_OPCODE(1), state);	/* loop list index */
 		push_stack(1, state);
@@ -981,6 +1084,7 @@ generate_stmt(Stmt * stmt, State * state)
 			   end_label, state->cur_stack - 2, state);
 		generate_stmt(stmt->s.list.body, state);
 		end_label = exit_loop(state);
+		blame_line(state->lineno, state);
 		emit_byte(OP_JUMP, state);
 		add_known_label(loop_top, state);
 		define_label(end_label, state);
@@ -992,6 +1096,7 @@ generate_stmt(Stmt * stmt, State * state)
 		Fixup loop_top;
 		int end_label;
 
+		blame_line(state->lineno++, state);
 		generate_expr(stmt->s.range.from, state);
 		generate_expr(stmt->s.range.to, state);
 		loop_top = capture_label(state);
@@ -1002,6 +1107,7 @@ generate_stmt(Stmt * stmt, State * state)
 			   end_label, state->cur_stack - 2, state);
 		generate_stmt(stmt->s.range.body, state);
 		end_label = exit_loop(state);
+		blame_line(state->lineno, state);
 		emit_byte(OP_JUMP, state);
 		add_known_label(loop_top, state);
 		define_label(end_label, state);
@@ -1013,6 +1119,7 @@ generate_stmt(Stmt * stmt, State * state)
 		Fixup loop_top;
 		int end_label;
 
+		blame_line(state->lineno++, state);
 		loop_top = capture_label(state);
 		generate_expr(stmt->s.loop.condition, state);
 		if (stmt->s.loop.id == -1)
@@ -1027,28 +1134,34 @@ generate_stmt(Stmt * stmt, State * state)
 			   end_label, state->cur_stack, state);
 		generate_stmt(stmt->s.loop.body, state);
 		end_label = exit_loop(state);
+		blame_line(state->lineno, state);
 		emit_byte(OP_JUMP, state);
 		add_known_label(loop_top, state);
 		define_label(end_label, state);
 	    }
 	    break;
 	case STMT_FORK:
+	    blame_line(state->lineno++, state);
 	    generate_expr(stmt->s.fork.time, state);
 	    if (stmt->s.fork.id >= 0)
 		emit_byte(OP_FORK_WITH_ID, state);
 	    else
 		emit_byte(OP_FORK, state);
-	    add_fork(stmt_to_code(stmt->s.fork.body, state->gstate), state);
+	    add_fork(stmt_to_code(stmt->s.fork.body, state->gstate,
+				  state->lineno), state);
+	    state->lineno += stmt_lines(stmt->s.fork.body);
 	    if (stmt->s.fork.id >= 0)
 		add_var_ref(stmt->s.fork.id, state);
 	    pop_stack(1, state);
 	    break;
 	case STMT_EXPR:
+	    blame_line(state->lineno, state);
 	    generate_expr(stmt->s.expr, state);
 	    emit_byte(OP_POP, state);
 	    pop_stack(1, state);
 	    break;
 	case STMT_RETURN:
+	    blame_line(state->lineno, state);
 	    if (stmt->s.expr) {
 		generate_expr(stmt->s.expr, state);
 		emit_ending_op(OP_RETURN, state);
@@ -1060,32 +1173,41 @@ generate_stmt(Stmt * stmt, State * state)
 	    {
 		int end_label, arm_count = 0;
 		Except_Arm *ex;
+		unsigned ex_line = (state->lineno + 1
+				    + stmt_lines(stmt->s.catch.body));
 
+		/* The codes are blamed on their `except' lines, below. */
 		for (ex = stmt->s.catch.excepts; ex; ex = ex->next) {
+		    blame_line(ex_line, state);
+		    ex_line += 1 + stmt_lines(ex->stmt);
 		    generate_codes(ex->codes, state);
 		    emit_extended_byte(EOP_PUSH_LABEL, state);
 		    ex->label = add_label(state);
 		    push_stack(1, state);
 		    arm_count++;
 		}
+		blame_line(state->lineno++, state);
 		emit_extended_byte(EOP_TRY_EXCEPT, state);
 		emit_byte(arm_count, state);
 		push_stack(1, state);
 		INCR_TRY_DEPTH(state);
 		generate_stmt(stmt->s.catch.body, state);
 		DECR_TRY_DEPTH(state);
+		blame_line(state->lineno - 1, state);
 		emit_extended_byte(EOP_END_EXCEPT, state);
 		end_label = add_label(state);
 		pop_stack(2 * arm_count + 1, state);	/* 2(codes,pc) + catch */
 		for (ex = stmt->s.catch.excepts; ex; ex = ex->next) {
 		    define_label(ex->label, state);
 		    push_stack(1, state);	/* exception tuple */
+		    blame_line(state->lineno++, state);
 		    if (ex->id >= 0)
 			emit_var_op(OP_PUT, ex->id, state);
 		    emit_byte(OP_POP, state);
 		    pop_stack(1, state);
 		    generate_stmt(ex->stmt, state);
 		    if (ex->next) {
+			blame_line(state->lineno - 1, state);
 			emit_byte(OP_JUMP, state);
 			end_label = add_linked_label(end_label, state);
 		    }
@@ -1097,17 +1219,20 @@ generate_stmt(Stmt * stmt, State * state)
 	    {
 		int handler_label;
 
+		blame_line(state->lineno++, state);
 		emit_extended_byte(EOP_TRY_FINALLY, state);
 		handler_label = add_label(state);
 		push_stack(1, state);
 		INCR_TRY_DEPTH(state);
 		generate_stmt(stmt->s.finally.body, state);
 		DECR_TRY_DEPTH(state);
+		blame_line(state->lineno++, state);
 		emit_extended_byte(EOP_END_FINALLY, state);
 		pop_stack(1, state);	/* FINALLY marker */
 		define_label(handler_label, state);
 		push_stack(2, state);	/* continuation value, reason */
 		generate_stmt(stmt->s.finally.handler, state);
+		blame_line(state->lineno, state);
 		emit_extended_byte(EOP_CONTINUE, state);
 		pop_stack(2, state);
 	    }
@@ -1118,6 +1243,7 @@ generate_stmt(Stmt * stmt, State * state)
 		int i;
 		Loop *loop = 0;	/* silence warnings */
 
+		blame_line(state->lineno, state);
 		if (stmt->s.exit == -1) {
 		    emit_extended_byte(EOP_EXIT, state);
 		    if (state->num_loops == 0)
@@ -1148,6 +1274,7 @@ generate_stmt(Stmt * stmt, State * state)
 	default:
 	    panic("Can't happen in GENERATE_STMT()");
 	}
+	state->lineno++;
     }
 }
 
@@ -1177,7 +1304,7 @@ bbd_cmp(int *a, int *b)
 #endif				/* BYTECODE_REDUCE_REF */
 
 static Bytecodes
-stmt_to_code(Stmt * stmt, GState * gstate)
+stmt_to_code(Stmt * stmt, GState * gstate, unsigned first_line)
 {
     State state;
     Bytecodes bc;
@@ -1190,10 +1317,12 @@ stmt_to_code(Stmt * stmt, GState * gstate)
 #endif
 #endif				/* BYTECODE_REDUCE_REF */
     Fixup *fixup;
+    Line_Run *run, *end_run;
 
-    init_state(&state, gstate);
+    init_state(&state, gstate, first_line);
 
     generate_stmt(stmt, &state);
+    blame_line(state.lineno, &state);
     emit_ending_op(OP_DONE, &state);
 
     if (state.cur_stack != 0)
@@ -1300,11 +1429,15 @@ stmt_to_code(Stmt * stmt, GState * gstate)
 
     fixup = state.fixups;
     fix_i = 0;
+    run = state.line_runs;
+    end_run = run + state.num_line_runs;
     /* For this loop, old_i and fix_i start at 0
      * and are always incremented, so casting to unsigned
      * (to silence vs-signed warnings) will be safe.
      * Not so in the previous loop. */
     for (old_i = new_i = 0; (unsigned)old_i < state.num_bytes; old_i++) {
+	if (run < end_run && run->pc == (unsigned)old_i)
+	    (run++)->pc = new_i;
 	if ((unsigned)fix_i < state.num_fixups && fixup->pc == (unsigned)old_i) {
 	    unsigned value, size = 0;	/* initialized to silence warning */
 
@@ -1355,6 +1488,11 @@ stmt_to_code(Stmt * stmt, GState * gstate)
 	    bc.vector[new_i++] = state.bytes[old_i];
     }
 
+    bc.num_line_runs = state.num_line_runs;
+    bc.line_runs = myrealloc(state.line_runs,
+			     sizeof(Line_Run) * state.num_line_runs,
+			     M_LINE_RUNS);
+
     free_state(state);
 
     return bc;
@@ -1368,7 +1506,7 @@ generate_code(Stmt * stmt, DB_Version version)
 
     init_gstate(&gstate);
 
-    prog->main_vector = stmt_to_code(stmt, &gstate);
+    prog->main_vector = stmt_to_code(stmt, &gstate, 0);
     prog->version = version;
 
     if (gstate.literals) {
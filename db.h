@@ -162,6 +162,23 @@ extern int db_object_bytes(Objid);
 
 extern Objid db_object_owner(Objid);
 extern void db_set_object_owner(Objid oid, Objid owner);
+extern int db_count_owned(Objid owner);
+extern int db_for_all_owned(Objid owner,
+			    int (*)(void *, Objid),
+			    void *);
+				/* OWNER need not be a valid object.  The
+				 * outcome is unspecified if any of the
+				 * following functions are called during a call
+				 * to db_for_all_owned():
+				 *      db_create_object()
+				 *      db_destroy_object()
+				 *      db_renumber_object()
+				 *      db_set_object_owner()
+				 */
+extern Num db_owned_bytes(Objid owner);
+				/* Returns the sum of db_object_bytes() over
+				 * all of the objects OWNER owns.
+				 */
 
 extern const char *db_object_name(Objid);
 extern void db_set_object_name(Objid oid, const char *name);
@@ -256,6 +273,32 @@ extern Var db_all_users(void);
 				 * module.  The caller should thus var_ref() it
 				 * to make it persistent.
 				 */
+
+typedef struct {
+    enum {
+	DBQ_DESCENDANTS,	/* proper descendants of OBJ */
+	DBQ_FLAGGED,		/* objects having FLAG set */
+	DBQ_DEFINING		/* objects defining a property NAME,
+				 * among those PROGR may read */
+    } kind;
+    Objid obj;
+    db_object_flag flag;
+    const char *name;
+    Objid progr;
+} db_object_query;
+
+extern Objid db_query_objects(const db_object_query *q,
+			      Objid start, Num count, Var *result);
+				/* Examines the objects numbered START through
+				 * START+COUNT-1, appending those matching Q
+				 * to the list *RESULT.  Returns the number of
+				 * the next object to examine, or NOTHING once
+				 * the end of the object table is reached.
+				 * DBQ_DESCENDANTS instead walks OBJ's children
+				 * lists, COUNT objects at a time, starting
+				 * with START == OBJ; the walk stops early if
+				 * START has since left OBJ's subtree.
+				 */
 
 
 /**** properties *****/
@@ -565,6 +608,13 @@ extern void db_set_verb_program(db_verb_handle, Program *);
 				 * it is to be persistent.
 				 */
 
+extern int db_precompile_verbs(int max);
+				/* Compiles up to MAX verbs whose source was
+				 * loaded but not yet compiled (see
+				 * LAZY_VERB_COMPILE in options.h).  Returns
+				 * true iff any such verbs might remain.
+				 */
+
 extern void db_verb_arg_specs(db_verb_handle h,
 			      db_arg_spec * dobj,
 			      db_prep_spec * prep,
@@ -58,6 +58,7 @@ read_verbdef(Verbdef * v)
 {
     v->next = 0;
     v->program = 0;
+    v->source = 0;
     return (dbio_read_string_intern(&v->name) &&
 	    dbio_read_objid(&v->owner) &&
 	    dbio_read_uint16(&v->perms) &&
@@ -596,6 +597,8 @@ read_db_file(void)
 	errlog("READ_DB_FILE: Errors in object hierarchies.\n");
 	return 0;
     }
+    dbpriv_link_hierarchies();
+
     oklog("LOADING: Reading %"PRIdN" MOO verb programs...\n", nprogs);
     for (i = 1; i <= nprogs; i++) {
 	if (!dbio_scxnf("#%"SCNdN":%"SCNdN, &oid, &vnum)) {
@@ -612,12 +615,29 @@ read_db_file(void)
 	    errlog("READ_DB_FILE: Unknown verb index: #%"PRIdN":%"PRIdN".\n", oid, vnum);
 	    return 0;
 	}
-	program = dbio_read_program(dbio_input_version, fmt_verb_name, &h);
-	if (!program) {
-	    errlog("READ_DB_FILE: Unparsable program #%"PRIdN":%"PRIdN".\n", oid, vnum);
-	    return 0;
+#ifdef LAZY_VERB_COMPILE
+	/* Older syntax gets compiled now so that we never have to
+	 * keep track of which version a saved source is in.
+	 */
+	if (dbio_input_version == current_db_version) {
+	    const char *source = dbio_read_program_text();
+
+	    if (!source) {
+		errlog("READ_DB_FILE: Bad program text #%"PRIdN":%"PRIdN".\n",
+		       oid, vnum);
+		return 0;
+	    }
+	    dbpriv_set_verb_source(h, source);
+	} else
+#endif
+	{
+	    program = dbio_read_program(dbio_input_version, fmt_verb_name, &h);
+	    if (!program) {
+		errlog("READ_DB_FILE: Unparsable program #%"PRIdN":%"PRIdN".\n", oid, vnum);
+		return 0;
+	    }
+	    db_set_verb_program(h, program);
 	}
-	db_set_verb_program(h, program);
 	if (i == nprogs || log_report_progress())
 	    oklog("LOADING: Done reading %"PRIdN" verb programs...\n", i);
     }
@@ -655,7 +675,7 @@ write_db_file(const char *reason)
     for (oid = 0; oid <= max_oid; oid++) {
 	if (valid(oid))
 	    for (v = dbpriv_find_object(oid)->verbdefs; v; v = v->next)
-		if (v->program)
+		if (v->program || v->source)
 		    nprogs++;
     }
 
@@ -679,9 +699,12 @@ write_db_file(const char *reason)
 		int vcount = 0;
 
 		for (v = dbpriv_find_object(oid)->verbdefs; v; v = v->next) {
-		    if (v->program) {
+		    if (v->program || v->source) {
 			dbio_printf("#%"PRIdN":%d\n", oid, vcount);
-			dbio_write_program(v->program);
+			if (v->source)
+			    dbio_printf("%s.\n", v->source);
+			else
+			    dbio_write_program(v->program);
 			if (++i == nprogs || log_report_progress())
 			    oklog("%s: Done writing %d verb programs...\n",
 				  reason, i);
@@ -698,9 +721,11 @@ write_db_file(const char *reason)
 	success = 0;
     ENDTRY;
 
+    if (!dbpriv_dbio_output_finished())
+	success = 0;
+
     db_run_after_save_hooks(success);
 
-    dbpriv_dbio_output_finished();
     return success;
 }
 
@@ -754,8 +779,8 @@ dump_database(Dump_Reason reason)
 
     success = 1;
     if ((f = fopen(temp_name, "w")) != 0) {
-	dbpriv_set_dbio_output(f);
-	if (!write_db_file(reason_names[reason])) {
+	if (!dbpriv_set_dbio_output(f)
+	    || !write_db_file(reason_names[reason])) {
 	    log_perror("Trying to dump database");
 	    fclose(f);
 	    remove(temp_name);
@@ -837,7 +862,10 @@ db_initialize(int *pargc, char ***pargv)
 int
 db_load(void)
 {
-    dbpriv_set_dbio_input(input_db);
+    if (!dbpriv_set_dbio_input(input_db)) {
+	log_perror("DB_LOAD: Cannot read database");
+	return 0;
+    }
 
     db_run_before_load_hooks();
 
@@ -28,7 +28,11 @@
 #include "my-stdio.h"
 #include "my-stdlib.h"
 #include "my-string.h"
+#include "my-unistd.h"
 #include <errno.h>
+#ifdef GZIP_DB
+#  include <zlib.h>
+#endif
 
 #include "exceptions.h"
 #include "list.h"
@@ -45,24 +49,57 @@
 #include "waif.h"
 
 
+#ifdef GZIP_DB
+/* Size of zlib's buffers, each way */
+#  define DBIO_GZ_BUFSIZE	(128 * 1024)
+#endif
+
 /*********** Input ***********/
 
+#ifdef GZIP_DB
+/* zlib inflates a gzipped db and passes a plain one through unchanged,
+ * so either kind can be loaded.
+ */
+static gzFile input;
+#  define input_getc()		gzgetc(input)
+#  define input_ungetc(c)	gzungetc(c, input)
+#  define input_gets(buf, n)	gzgets(input, buf, n)
+#  define input_pos()		((long) gztell(input))
+#else
 static FILE *input;
+#  define input_getc()		fgetc(input)
+#  define input_ungetc(c)	ungetc(c, input)
+#  define input_gets(buf, n)	fgets(buf, n, input)
+#  define input_pos()		ftell(input)
+#endif
 
 static const char *dbio_last_error = NULL;
 
-void
+int
 dbpriv_set_dbio_input(FILE * f)
 {
+#ifdef GZIP_DB
+    int fd = dup(fileno(f));
+
+    if (fd < 0)
+	return 0;
+    if (!(input = gzdopen(fd, "rb"))) {
+	close(fd);
+	return 0;
+    }
+    gzbuffer(input, DBIO_GZ_BUFSIZE);
+#else
     input = f;
+#endif
+    return 1;
 }
 
 int
 dbio_peek_byte(void)
 {
-    int c = fgetc(input);
+    int c = input_getc();
     if (EOF != c)
-	ungetc(c, input);
+	input_ungetc(c);
     return c;
 }
 
@@ -70,7 +107,7 @@ int
 dbio_skip_lines(size_t n, const char *caller)
 {
     int32_t c;
-    while ((EOF != (c = getc(input)))
+    while ((EOF != (c = input_getc()))
 	   && (c != '\n' || --n));
     if (n) {
 	errlog("%s: Unexpected end of file\n", caller);
@@ -88,6 +125,12 @@ static Stream *dbio_line_stream = 0;
 void
 dbpriv_dbio_input_finished(void)
 {
+#ifdef GZIP_DB
+    if (input) {
+	gzclose(input);
+	input = 0;
+    }
+#endif
     if (dbio_line_stream) {
 	free_stream(dbio_line_stream);
 	dbio_line_stream = 0;
@@ -105,7 +148,7 @@ dbio_read_line(const char **end)
 
     do {
 	stream_beginfill(dbio_line_stream, 2, &buffer, &blen);
-	if (!fgets(buffer, blen + 1, input))
+	if (!input_gets(buffer, blen + 1))
 	    break;
 	len = strlen(buffer);
 	stream_endfill(dbio_line_stream, blen - len);
@@ -223,7 +266,7 @@ dbio_read_integer(enum dbio_intrange range_id, intmax_t *ip)
 
     if (dbio_last_error) {
 	errlog("DBIO_READ_INTEGER: %s: \"%s\" at file pos. %ld\n",
-	       dbio_last_error, s, ftell(input));
+	       dbio_last_error, s, input_pos());
 	return 0;
     }
     return 1;
@@ -247,7 +290,7 @@ dbio_read_float(FlBox *fbp)
 
     if (dbio_last_error) {
 	errlog("DBIO_READ_FLOAT: %s: \"%s\" at file pos. %ld\n",
-	       dbio_last_error, s, ftell(input));
+	       dbio_last_error, s, input_pos());
 	return 0;
     }
     *fbp = box_fl(d);
@@ -334,7 +377,7 @@ dbio_read_var_value(intmax_t vtype, Var *vp)
     default:
 	dbio_last_error = "Unknown Var type";
 	errlog("DBIO_READ_VAR: Unknown type (%jd) at DB file pos. %ld\n",
-	       vtype, ftell(input));
+	       vtype, input_pos());
     bad_value:
 	*vp = zero;
 	return 0;
@@ -538,6 +581,7 @@ dbio_scxnf(const char *format,...)
 
 struct state {
     char prev_char;
+    const char *text;		/* if non-null, read from here, not input */
     const char *(*fmtr) (void *);
     void *data;
 };
@@ -571,10 +615,13 @@ my_getc(void *data)
     struct state *s = data;
     int c;
 
-    c = fgetc(input);
+    if (s->text)
+	return *s->text ? (unsigned char) *s->text++ : EOF;
+
+    c = input_getc();
     if (c == '.' && s->prev_char == '\n') {
 	/* end-of-verb marker in DB */
-	c = fgetc(input);	/* skip next newline */
+	c = input_getc();	/* skip next newline */
 	return EOF;
     }
     if (c == EOF)
@@ -592,6 +639,43 @@ dbio_read_program(DB_Version version, const char *(*fmtr) (void *), void *data)
     struct state s;
 
     s.prev_char = '\n';
+    s.text = 0;
+    s.fmtr = fmtr;
+    s.data = data;
+    return parse_program(version, parser_client, &s);
+}
+
+const char *
+dbio_read_program_text(void)
+{
+    static Stream *str = 0;
+    int c, prev_char = '\n';
+
+    if (!str)
+	str = new_stream(1024);
+
+    while ((c = input_getc()) != EOF) {
+	if (c == '.' && prev_char == '\n') {
+	    /* end-of-verb marker in DB */
+	    input_getc();	/* skip next newline */
+	    return str_dup(reset_stream(str));
+	}
+	stream_add_char(str, c);
+	prev_char = c;
+    }
+    reset_stream(str);
+    dbio_last_error = "Unexpected EOF in program text";
+    return 0;
+}
+
+Program *
+dbio_parse_program_text(DB_Version version, const char *text,
+			const char *(*fmtr) (void *), void *data)
+{
+    struct state s;
+
+    s.prev_char = '\n';
+    s.text = text;
     s.fmtr = fmtr;
     s.data = data;
     return parse_program(version, parser_client, &s);
@@ -602,23 +686,73 @@ dbio_read_program(DB_Version version, const char *(*fmtr) (void *), void *data)
 
 Exception dbpriv_dbio_failed;
 
+#ifdef GZIP_DB
+/* Output is collected in dbio_gz_stream and handed to zlib a buffer's
+ * worth at a time; gzprintf() can't be used, as it truncates anything
+ * longer than its buffer (and verb sources can be).
+ */
+static gzFile output;
+static Stream *dbio_gz_stream = NULL;
+
+static int
+dbio_gz_flush(void)
+{
+    size_t len = stream_length(dbio_gz_stream);
+
+    return (len == 0
+	    || gzwrite(output, reset_stream(dbio_gz_stream), len) == (int) len);
+}
+#else
 static FILE *output;
+#endif
 
 static Stream *dbio_float_stream = NULL;
 
-void
+int
 dbpriv_set_dbio_output(FILE * f)
 {
+#ifdef GZIP_DB
+    int fd = dup(fileno(f));
+
+    if (fd < 0)
+	return 0;
+    if (!(output = gzdopen(fd, "wb"))) {
+	close(fd);
+	return 0;
+    }
+    gzbuffer(output, DBIO_GZ_BUFSIZE);
+    gzsetparams(output, GZIP_DB_LEVEL, Z_DEFAULT_STRATEGY);
+    if (!dbio_gz_stream)
+	dbio_gz_stream = new_stream(DBIO_GZ_BUFSIZE + 1024);
+#else
     output = f;
+#endif
+    return 1;
 }
 
-void
+int
 dbpriv_dbio_output_finished(void)
 {
+    int success = 1;
+
+#ifdef GZIP_DB
+    if (output) {
+	if (!dbio_gz_flush())
+	    success = 0;
+	if (gzclose(output) != Z_OK)
+	    success = 0;
+	output = 0;
+    }
+    if (dbio_gz_stream) {
+	free_stream(dbio_gz_stream);
+	dbio_gz_stream = NULL;
+    }
+#endif
     if (dbio_float_stream) {
 	free_stream(dbio_float_stream);
 	dbio_float_stream = NULL;
     }
+    return success;
 }
 
 void
@@ -627,8 +761,15 @@ dbio_printf(const char *format,...)
     va_list args;
 
     va_start(args, format);
+#ifdef GZIP_DB
+    stream_vprintf(dbio_gz_stream, format, args);
+    if (stream_length(dbio_gz_stream) >= DBIO_GZ_BUFSIZE
+	&& !dbio_gz_flush())
+	RAISE(dbpriv_dbio_failed, 0);
+#else
     if (vfprintf(output, format, args) < 0)
 	RAISE(dbpriv_dbio_failed, 0);
+#endif
     va_end(args);
 }
 
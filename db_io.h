@@ -146,6 +146,22 @@ extern Program *dbio_read_program(DB_Version version,
 				 * be the required string.
 				 */
 
+extern const char *dbio_read_program_text(void);
+				/* Reads the text of a program, up to and
+				 * including its terminating "." line, without
+				 * parsing it; returns it as a string (without
+				 * the terminator) or null on failure.
+				 */
+
+extern Program *dbio_parse_program_text(DB_Version version,
+					const char *text,
+					const char *(*fmtr) (void *),
+					void *data);
+				/* Parses TEXT as dbio_read_program() would
+				 * have parsed it from the DB file.  FMTR and
+				 * DATA are as for dbio_read_program().
+				 */
+
 /*--------------*
  |  dbio_scxnf  |
  *--------------*/
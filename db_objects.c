@@ -33,6 +33,59 @@ static int num_objects = 0;
 static int max_objects = 0;
 
 static Var all_users;
+
+static void owned_link(Object *o);
+static void owned_unlink(Object *o);
+static void owned_rename(Object *o);
+
+/* The contents and children lists are doubly linked, with the list
+ * owner also keeping the tail and length, so that unlinking, appending
+ * and counting are all O(1).
+ */
+
+#define LL_REMOVE(where, listname, lastname, countname, \
+		  what, nextname, prevname) { \
+    Object *lw = objects[what]; \
+    if (lw->prevname == NOTHING) \
+	objects[where]->listname = lw->nextname; \
+    else \
+	objects[lw->prevname]->nextname = lw->nextname; \
+    if (lw->nextname == NOTHING) \
+	objects[where]->lastname = lw->prevname; \
+    else \
+	objects[lw->nextname]->prevname = lw->prevname; \
+    objects[where]->countname--; \
+    lw->nextname = lw->prevname = NOTHING; \
+}
+
+#define LL_APPEND(where, listname, lastname, countname, \
+		  what, nextname, prevname) { \
+    Object *lo = objects[where]; \
+    Object *lw = objects[what]; \
+    lw->prevname = lo->lastname; \
+    lw->nextname = NOTHING; \
+    if (lo->lastname == NOTHING) \
+	lo->listname = what; \
+    else \
+	objects[lo->lastname]->nextname = what; \
+    lo->lastname = what; \
+    lo->countname++; \
+}
+
+/* The object now at objects[new] has just been renumbered; point its
+ * neighbors on WHERE's list at its new number.
+ */
+#define LL_RENAME(where, listname, lastname, new, nextname, prevname) { \
+    Object *lw = objects[new]; \
+    if (lw->prevname == NOTHING) \
+	objects[where]->listname = new; \
+    else \
+	objects[lw->prevname]->nextname = new; \
+    if (lw->nextname == NOTHING) \
+	objects[where]->lastname = new; \
+    else \
+	objects[lw->nextname]->prevname = new; \
+}
 
 
 /*********** Objects qua objects ***********/
@@ -101,6 +154,48 @@ dbpriv_new_object(void)
     return o;
 }
 
+void
+dbpriv_link_hierarchies(void)
+{
+    Objid oid;
+
+    for (oid = 0; oid < num_objects; oid++) {
+	Object *o = objects[oid];
+
+	if (o) {
+	    o->prev = o->prev_sibling = NOTHING;
+	    o->last_content = o->last_child = NOTHING;
+	    o->ncontents = o->nchildren = 0;
+	    o->next_owned = o->prev_owned = NOTHING;
+	}
+    }
+    for (oid = 0; oid < num_objects; oid++) {
+	Object *o = objects[oid];
+	Objid c, last;
+
+	if (!o)
+	    continue;
+
+	for (last = NOTHING, c = o->contents;
+	     c != NOTHING;
+	     last = c, c = objects[c]->next) {
+	    objects[c]->prev = last;
+	    o->ncontents++;
+	}
+	o->last_content = last;
+
+	for (last = NOTHING, c = o->child;
+	     c != NOTHING;
+	     last = c, c = objects[c]->sibling) {
+	    objects[c]->prev_sibling = last;
+	    o->nchildren++;
+	}
+	o->last_child = last;
+
+	owned_link(o);
+    }
+}
+
 void
 dbpriv_new_recycled_object(void)
 {
@@ -121,6 +216,12 @@ db_create_object(void)
     o->flags = 0;
     o->parent = o->child = o->sibling = NOTHING;
     o->location = o->contents = o->next = NOTHING;
+    o->prev = o->prev_sibling = NOTHING;
+    o->last_content = o->last_child = NOTHING;
+    o->ncontents = o->nchildren = 0;
+
+    o->owner = NOTHING;
+    owned_link(o);
 
     o->propval = 0;
 
@@ -156,6 +257,7 @@ db_destroy_object(Objid oid)
 	t.v.obj = oid;
 	all_users = setremove(all_users, t);
     }
+    owned_unlink(o);
     free_str(o->name);
 
     for (i = 0; i < o->propdefs.cur_length; i++) {
@@ -173,6 +275,8 @@ db_destroy_object(Objid oid)
     for (v = o->verbdefs; v; v = w) {
 	if (v->program)
 	    free_program(v->program);
+	if (v->source)
+	    free_str(v->source);
 	free_str(v->name);
 	w = v->next;
 	myfree(v, M_VERBDEF);
@@ -196,19 +300,15 @@ db_renumber_object(Objid old)
 	    o = objects[new] = objects[old];
 	    objects[old] = 0;
 	    objects[new]->id = new;
+	    owned_rename(o);
 
 	    /* Fix up the parent/children hierarchy */
 	    {
-		Objid oid, *oidp;
-
-		if (o->parent != NOTHING) {
-		    oidp = &objects[o->parent]->child;
-		    while (*oidp != old && *oidp != NOTHING)
-			oidp = &objects[*oidp]->sibling;
-		    if (*oidp == NOTHING)
-			panic("Object not in parent's children list");
-		    *oidp = new;
-		}
+		Objid oid;
+
+		if (o->parent != NOTHING)
+		    LL_RENAME(o->parent, child, last_child,
+			      new, sibling, prev_sibling);
 		for (oid = o->child;
 		     oid != NOTHING;
 		     oid = objects[oid]->sibling)
@@ -217,16 +317,11 @@ db_renumber_object(Objid old)
 
 	    /* Fix up the location/contents hierarchy */
 	    {
-		Objid oid, *oidp;
-
-		if (o->location != NOTHING) {
-		    oidp = &objects[o->location]->contents;
-		    while (*oidp != old && *oidp != NOTHING)
-			oidp = &objects[*oidp]->next;
-		    if (*oidp == NOTHING)
-			panic("Object not in location's contents list");
-		    *oidp = new;
-		}
+		Objid oid;
+
+		if (o->location != NOTHING)
+		    LL_RENAME(o->location, contents, last_content,
+			      new, next, prev);
 		for (oid = o->contents;
 		     oid != NOTHING;
 		     oid = objects[oid]->next)
@@ -257,9 +352,9 @@ db_renumber_object(Objid old)
 			continue;
 
 		    if (o->owner == new)
-			o->owner = NOTHING;
+			db_set_object_owner(oid, NOTHING);
 		    else if (o->owner == old)
-			o->owner = new;
+			db_set_object_owner(oid, new);
 
 		    for (v = o->verbdefs; v; v = v->next)
 			if (v->owner == new)
@@ -298,7 +393,7 @@ db_object_bytes(Objid oid)
     for (v = o->verbdefs; v; v = v->next) {
 	count += BQM_SIZEOF(Verbdef);
 	count += memo_strlen(v->name) + 1;
-	if (v->program)
+	if (dbpriv_verbdef_program(v, o->id))
 	    count += program_bytes(v->program);
     }
 
@@ -315,6 +410,181 @@ db_object_bytes(Objid oid)
 }
 
 
+/*********** Owner index ***********/
+
+/* For each owner, the objects it owns are doubly linked through their
+ * next_owned/prev_owned fields.  Since owners need not be valid objects,
+ * the list heads live in a hash table keyed by owner rather than on the
+ * owning objects themselves.
+ */
+
+typedef struct Owned Owned;
+
+struct Owned {
+    Owned *next;		/* hash chain */
+    Objid owner;
+    Objid first, last;
+    int count;
+};
+
+static Owned **owned_table = 0;
+static unsigned owned_table_size = 0;
+static unsigned owned_entries = 0;
+
+#define OWNED_BUCKET(owner, size)	((UNum) (owner) % (size))
+
+static Owned **
+owned_find(Objid owner)
+{
+    Owned **pp;
+
+    if (!owned_table)
+	return 0;
+    for (pp = &owned_table[OWNED_BUCKET(owner, owned_table_size)];
+	 *pp; pp = &(*pp)->next)
+	if ((*pp)->owner == owner)
+	    return pp;
+    return 0;
+}
+
+static void
+owned_grow(void)
+{
+    unsigned i, new_size = owned_table_size ? owned_table_size * 2 : 1024;
+    Owned **new_table = mymalloc(new_size * sizeof(Owned *), M_OWNED_TABLE);
+
+    for (i = 0; i < new_size; i++)
+	new_table[i] = 0;
+    for (i = 0; i < owned_table_size; i++) {
+	Owned *e, *next;
+
+	for (e = owned_table[i]; e; e = next) {
+	    unsigned b = OWNED_BUCKET(e->owner, new_size);
+
+	    next = e->next;
+	    e->next = new_table[b];
+	    new_table[b] = e;
+	}
+    }
+    if (owned_table)
+	myfree(owned_table, M_OWNED_TABLE);
+    owned_table = new_table;
+    owned_table_size = new_size;
+}
+
+static void
+owned_link(Object *o)
+{
+    Owned **pp = owned_find(o->owner);
+    Owned *e;
+
+    if (pp)
+	e = *pp;
+    else {
+	unsigned b;
+
+	if (owned_entries >= owned_table_size)
+	    owned_grow();
+	b = OWNED_BUCKET(o->owner, owned_table_size);
+	e = mymalloc(sizeof(Owned), M_OWNED_ENTRY);
+	e->owner = o->owner;
+	e->first = e->last = NOTHING;
+	e->count = 0;
+	e->next = owned_table[b];
+	owned_table[b] = e;
+	owned_entries++;
+    }
+
+    o->prev_owned = e->last;
+    o->next_owned = NOTHING;
+    if (e->last == NOTHING)
+	e->first = o->id;
+    else
+	objects[e->last]->next_owned = o->id;
+    e->last = o->id;
+    e->count++;
+}
+
+static void
+owned_unlink(Object *o)
+{
+    Owned **pp = owned_find(o->owner);
+    Owned *e;
+
+    if (!pp)
+	panic("Object not in its owner's index entry");
+    e = *pp;
+
+    if (o->prev_owned == NOTHING)
+	e->first = o->next_owned;
+    else
+	objects[o->prev_owned]->next_owned = o->next_owned;
+    if (o->next_owned == NOTHING)
+	e->last = o->prev_owned;
+    else
+	objects[o->next_owned]->prev_owned = o->prev_owned;
+    o->next_owned = o->prev_owned = NOTHING;
+
+    if (--e->count == 0) {
+	*pp = e->next;
+	myfree(e, M_OWNED_ENTRY);
+	owned_entries--;
+    }
+}
+
+/* O has just been renumbered; point its neighbors at its new number. */
+static void
+owned_rename(Object *o)
+{
+    Owned *e = *owned_find(o->owner);
+
+    if (o->prev_owned == NOTHING)
+	e->first = o->id;
+    else
+	objects[o->prev_owned]->next_owned = o->id;
+    if (o->next_owned == NOTHING)
+	e->last = o->id;
+    else
+	objects[o->next_owned]->prev_owned = o->id;
+}
+
+int
+db_count_owned(Objid owner)
+{
+    Owned **pp = owned_find(owner);
+
+    return pp ? (*pp)->count : 0;
+}
+
+int
+db_for_all_owned(Objid owner, int (*func) (void *, Objid), void *data)
+{
+    Owned **pp = owned_find(owner);
+    Objid oid;
+
+    if (pp)
+	for (oid = (*pp)->first; oid != NOTHING; oid = objects[oid]->next_owned)
+	    if (func(data, oid))
+		return 1;
+
+    return 0;
+}
+
+Num
+db_owned_bytes(Objid owner)
+{
+    Owned **pp = owned_find(owner);
+    Objid oid;
+    Num bytes = 0;
+
+    if (pp)
+	for (oid = (*pp)->first; oid != NOTHING; oid = objects[oid]->next_owned)
+	    bytes += db_object_bytes(oid);
+
+    return bytes;
+}
+
+
 /*********** Object attributes ***********/
 
 Objid
@@ -326,7 +596,13 @@ db_object_owner(Objid oid)
 void
 db_set_object_owner(Objid oid, Objid owner)
 {
-    objects[oid]->owner = owner;
+    Object *o = objects[oid];
+
+    if (o->owner != owner) {
+	owned_unlink(o);
+	o->owner = owner;
+	owned_link(o);
+    }
 }
 
 const char *
@@ -354,13 +630,7 @@ db_object_parent(Objid oid)
 int
 db_count_children(Objid oid)
 {
-    Objid c;
-    int i = 0;
-
-    for (c = objects[oid]->child; c != NOTHING; c = objects[c]->sibling)
-	i++;
-
-    return i;
+    return objects[oid]->nchildren;
 }
 
 int
@@ -375,36 +645,6 @@ db_for_all_children(Objid oid, int (*func) (void *, Objid), void *data)
     return 0;
 }
 
-#define LL_REMOVE(where, listname, what, nextname) { \
-    Objid lid; \
-    if (objects[where]->listname == what) \
-	objects[where]->listname = objects[what]->nextname; \
-    else { \
-	for (lid = objects[where]->listname; lid != NOTHING; \
-	      lid = objects[lid]->nextname) { \
-	    if (objects[lid]->nextname == what) { \
-		objects[lid]->nextname = objects[what]->nextname; \
-		break; \
-	    } \
-	} \
-    } \
-    objects[what]->nextname = NOTHING; \
-}
-
-#define LL_APPEND(where, listname, what, nextname) { \
-    Objid lid; \
-    if (objects[where]->listname == NOTHING) { \
-	objects[where]->listname = what; \
-    } else { \
-	for (lid = objects[where]->listname; \
-	     objects[lid]->nextname != NOTHING; \
-	     lid = objects[lid]->nextname) \
-	    ; \
-	objects[lid]->nextname = what; \
-    } \
-    objects[what]->nextname = NOTHING; \
-}
-
 int
 db_change_parent(Objid oid, Objid parent)
 {
@@ -429,10 +669,12 @@ db_change_parent(Objid oid, Objid parent)
     old_parent = objects[oid]->parent;
 
     if (old_parent != NOTHING)
-	LL_REMOVE(old_parent, child, oid, sibling);
+	LL_REMOVE(old_parent, child, last_child, nchildren,
+		  oid, sibling, prev_sibling);
 
     if (parent != NOTHING)
-	LL_APPEND(parent, child, oid, sibling);
+	LL_APPEND(parent, child, last_child, nchildren,
+		  oid, sibling, prev_sibling);
 
     objects[oid]->parent = parent;
     dbpriv_fix_properties_after_chparent(oid, old_parent);
@@ -449,13 +691,7 @@ db_object_location(Objid oid)
 int
 db_count_contents(Objid oid)
 {
-    Objid c;
-    int i = 0;
-
-    for (c = objects[oid]->contents; c != NOTHING; c = objects[c]->next)
-	i++;
-
-    return i;
+    return objects[oid]->ncontents;
 }
 
 int
@@ -476,10 +712,12 @@ db_change_location(Objid oid, Objid location)
     Objid old_location = objects[oid]->location;
 
     if (valid(old_location))
-	LL_REMOVE(old_location, contents, oid, next);
+	LL_REMOVE(old_location, contents, last_content, ncontents,
+		  oid, next, prev);
 
     if (valid(location))
-	LL_APPEND(location, contents, oid, next);
+	LL_APPEND(location, contents, last_content, ncontents,
+		  oid, next, prev);
 
     objects[oid]->location = location;
 }
@@ -554,6 +792,96 @@ dbpriv_set_all_users(Var v)
     all_users = v;
 }
 
+static int
+query_matches(const db_object_query *q, Object *o, int phash)
+{
+    int i;
+
+    switch (q->kind) {
+    case DBQ_DESCENDANTS:	/* handled by query_descendants() */
+	return 0;
+    case DBQ_FLAGGED:
+	return (o->flags & (1 << q->flag)) != 0;
+    case DBQ_DEFINING:
+	for (i = 0; i < o->propdefs.cur_length; i++)
+	    if (o->propdefs.l[i].hash == phash
+		&& !mystrcasecmp(o->propdefs.l[i].name, q->name))
+		return db_object_allows(o->id, q->progr, FLAG_READ);
+	return 0;
+    }
+    return 0;
+}
+
+/* Returns the object after OID in a preorder walk of ROOT's descendants,
+ * or NOTHING if OID is the last.
+ */
+static Objid
+next_descendant(Objid root, Objid oid)
+{
+    if (objects[oid]->child != NOTHING)
+	return objects[oid]->child;
+    for (; oid != root; oid = objects[oid]->parent)
+	if (objects[oid]->sibling != NOTHING)
+	    return objects[oid]->sibling;
+    return NOTHING;
+}
+
+static Objid
+query_descendants(Objid root, Objid start, Num count, Var *result)
+{
+    Objid oid;
+    Var v;
+
+    if (!valid(root))
+	return NOTHING;
+    if (start == root)
+	oid = next_descendant(root, root);
+    else {
+	/* The hierarchy may have changed since the last call. */
+	for (oid = valid(start) ? objects[start]->parent : NOTHING;
+	     oid != NOTHING && oid != root; oid = objects[oid]->parent)
+	    ;
+	if (oid != root)
+	    return NOTHING;
+	oid = start;
+    }
+
+    v.type = TYPE_OBJ;
+    for (; oid != NOTHING && count > 0; count--) {
+	v.v.obj = oid;
+	*result = listappend(*result, v);
+	oid = next_descendant(root, oid);
+    }
+    return oid;
+}
+
+Objid
+db_query_objects(const db_object_query *q,
+		 Objid start, Num count, Var *result)
+{
+    int phash = q->kind == DBQ_DEFINING ? str_hash(q->name) : 0;
+    Objid oid, end;
+
+    if (q->kind == DBQ_DESCENDANTS)
+	return query_descendants(q->obj, start, count, result);
+    if (start < 0)
+	start = 0;
+    end = (count >= num_objects - start ? num_objects : start + count);
+
+    for (oid = start; oid < end; oid++) {
+	Object *o = objects[oid];
+	Var v;
+
+	if (o && query_matches(q, o, phash)) {
+	    v.type = TYPE_OBJ;
+	    v.v.obj = oid;
+	    *result = listappend(*result, v);
+	}
+    }
+
+    return end < num_objects ? end : NOTHING;
+}
+
 
 /*
  * $Log$
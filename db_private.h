@@ -24,6 +24,7 @@
 
 #include "config.h"
 
+#include "db.h"
 #include "exceptions.h"
 #include "program.h"
 #include "structures.h"
@@ -33,6 +34,7 @@ typedef struct Verbdef Verbdef;
 struct Verbdef {
     const char *name;
     Program *program;
+    const char *source;		/* not-yet-compiled text, if any */
     Objid owner;
     uint16_t perms;
     int16_t  prep;
@@ -73,6 +75,20 @@ typedef struct Object {
     Objid child;
     Objid sibling;
 
+    /* The following are not saved in the DB file but rather are
+     * reconstructed at load time by dbpriv_link_hierarchies().
+     * With them, unlinking from or appending to a contents or
+     * children list, and counting either, are all constant-time.
+     */
+    Objid prev;			/* previous in location's contents list */
+    Objid prev_sibling;		/* previous in parent's children list */
+    Objid last_content;		/* tail of contents list */
+    Objid last_child;		/* tail of children list */
+    int ncontents;
+    int nchildren;
+    Objid next_owned;		/* neighbors in the owner index */
+    Objid prev_owned;
+
     const char *name;
     uint16_t flags;
 
@@ -132,6 +148,15 @@ extern Object *dbpriv_find_object(Objid);
 				/* Returns 0 if given object is not valid.
 				 */
 
+extern void dbpriv_link_hierarchies(void);
+				/* Fill in the back-links, list tails and
+				 * list lengths of every object from the
+				 * forward links read from the DB file, and
+				 * build the owner index.  Must be called
+				 * after the hierarchies are validated and
+				 * before anything else touches them.
+				 */
+
 /*********** Properties ***********/
 
 extern Propdef dbpriv_new_propdef(const char *name);
@@ -162,6 +187,22 @@ extern void dbpriv_build_prep_table(void);
 				 * prepositional-phrase matching table.
 				 */
 
+extern void dbpriv_set_verb_source(db_verb_handle, const char *source);
+				/* Gives the verb SOURCE (a string, which is
+				 * consumed) in place of a program; it will be
+				 * compiled on first use.  SOURCE must be in
+				 * the current DB version's syntax.
+				 */
+
+extern Program *dbpriv_verbdef_program(Verbdef *, Objid definer);
+				/* Returns the verb's program, compiling its
+				 * source first if need be; returns null for
+				 * a verb that has never been programmed.  A
+				 * verb whose source fails to compile gets the
+				 * null program but keeps its source, so that
+				 * it is saved unchanged.
+				 */
+
 /*********** DBIO ***********/
 
 extern Exception dbpriv_dbio_failed;
@@ -169,12 +210,18 @@ extern Exception dbpriv_dbio_failed;
 				 * running out of disk space for the dump).
 				 */
 
-extern void dbpriv_set_dbio_input(FILE *);
-extern void dbpriv_set_dbio_output(FILE *);
+extern int dbpriv_set_dbio_input(FILE *);
+extern int dbpriv_set_dbio_output(FILE *);
+				/* Return false if the file can't be used
+				 * (only possible under GZIP_DB, where DBIO
+				 * reads and writes it through zlib).
+				 */
 
 extern void dbpriv_dbio_input_finished(void);
-extern void dbpriv_dbio_output_finished(void);
-				/* Do internal cleanups.
+extern int dbpriv_dbio_output_finished(void);
+				/* Do internal cleanups; the latter returns
+				 * false if buffered output couldn't be
+				 * written.
 				 */
 
 #endif		/* !DB_Private_H */
@@ -26,13 +26,16 @@
 #include "my-stdlib.h"
 #include "my-string.h"
 
+#include "db_io.h"
 #include "db_tune.h"
 #include "list.h"
 #include "log.h"
 #include "parse_cmd.h"
 #include "program.h"
 #include "storage.h"
+#include "streams.h"
 #include "utils.h"
+#include "version.h"
 
 
 /*********** Prepositions ***********/
@@ -211,6 +214,7 @@ db_add_verb(Objid oid, const char *vnames, Objid owner, unsigned flags,
     newv->prep = prep;
     newv->next = 0;
     newv->program = 0;
+    newv->source = 0;
     if (o->verbdefs) {
 	for (v = o->verbdefs, count = 2; v->next; v = v->next, ++count);
 	v->next = newv;
@@ -289,6 +293,8 @@ db_delete_verb(db_verb_handle vh)
 
     if (v->program)
 	free_program(v->program);
+    if (v->source)
+	free_str(v->source);
     if (v->name)
 	free_str(v->name);
     myfree(v, M_VERBDEF);
@@ -694,7 +700,7 @@ db_verb_program(db_verb_handle vh)
     if (!h)
 	panic("DB_VERB_PROGRAM: Null handle!");
 
-    Program *p = h->verbdef->program;
+    Program *p = dbpriv_verbdef_program(h->verbdef, h->definer);
     return p ? p : null_program();
 }
 
@@ -712,9 +718,92 @@ db_set_verb_program(db_verb_handle vh, Program * program)
 
     if (h->verbdef->program)
 	free_program(h->verbdef->program);
+    if (h->verbdef->source) {
+	free_str(h->verbdef->source);
+	h->verbdef->source = 0;
+    }
     h->verbdef->program = program;
 }
 
+void
+dbpriv_set_verb_source(db_verb_handle vh, const char *source)
+{
+    handle *h = (handle *) vh.ptr;
+
+    if (!h)
+	panic("DBPRIV_SET_VERB_SOURCE: Null handle!");
+
+    db_set_verb_program(vh, 0);
+    h->verbdef->source = source;
+}
+
+struct lazy_verb {
+    Objid definer;
+    Verbdef *v;
+};
+
+static const char *
+fmt_lazy_verb_name(void *data)
+{
+    struct lazy_verb *lv = data;
+    static Stream *s = 0;
+
+    if (!s)
+	s = new_stream(40);
+
+    stream_printf(s, "#%"PRIdN":%s", lv->definer, lv->v->name);
+    return reset_stream(s);
+}
+
+Program *
+dbpriv_verbdef_program(Verbdef *v, Objid definer)
+{
+    struct lazy_verb lv;
+    Program *p;
+
+    if (v->program || !v->source)
+	return v->program;
+
+    lv.definer = definer;
+    lv.v = v;
+    p = dbio_parse_program_text(current_db_version, v->source,
+				fmt_lazy_verb_name, &lv);
+    if (p) {
+	free_str(v->source);
+	v->source = 0;
+    } else {
+	errlog("DB_VERB_PROGRAM: Unparsable program %s; "
+	       "running it as an empty verb.\n", fmt_lazy_verb_name(&lv));
+	p = program_ref(null_program());
+    }
+    return v->program = p;
+}
+
+/* Where db_precompile_verbs() left off.  Sources only ever arrive
+ * during DB loading, so one pass over the objects suffices.
+ */
+static Objid precompile_cursor = 0;
+
+int
+db_precompile_verbs(int max)
+{
+    Objid last = db_last_used_objid();
+    Object *o;
+    Verbdef *v;
+
+    for (; precompile_cursor <= last; precompile_cursor++) {
+	if (!(o = dbpriv_find_object(precompile_cursor)))
+	    continue;
+	for (v = o->verbdefs; v; v = v->next)
+	    if (v->source && !v->program) {
+		if (max-- <= 0)
+		    return 1;
+		dbpriv_verbdef_program(v, o->id);
+	    }
+    }
+    return 0;
+}
+
 void
 db_verb_arg_specs(db_verb_handle vh,
 	     db_arg_spec * dobj, db_prep_spec * prep, db_arg_spec * iobj)
@@ -997,13 +997,32 @@ find_hot_node(Stmt * stmt)
     return 0;
 }
 
+/* Line numbers come from the table code_gen.c builds for each vector, which
+ * blames every byte on the same line find_hot_node() would; decompiling is
+ * only needed for a vector compiled without one.
+ */
 unsigned
 find_line_number(Program * prog, int vector, unsigned pc)
 {
+    Bytecodes bc = (vector == MAIN_VECTOR
+		    ? prog->main_vector
+		    : prog->fork_vectors[vector]);
     Stmt *tree;
 
-    if (prog->cached_lineno_pc == pc && prog->cached_lineno_vec == vector)
-	return prog->cached_lineno;
+    if (bc.line_runs) {
+	unsigned lo = 0, hi = bc.num_line_runs;
+
+	/* Find the last run starting at or before PC. */
+	while (hi - lo > 1) {
+	    unsigned mid = (lo + hi) / 2;
+
+	    if (bc.line_runs[mid].pc <= pc)
+		lo = mid;
+	    else
+		hi = mid;
+	}
+	return prog->first_lineno + bc.line_runs[lo].line;
+    }
 
     tree = program_to_tree(prog, MAIN_VECTOR, vector, pc + 1);
 
@@ -1014,9 +1033,6 @@ find_line_number(Program * prog, int vector, unsigned pc)
     if (!hot_node && hot_position != DONE)
 	panic("Can't do job in FIND_LINE_NUMBER!");
 
-    prog->cached_lineno_vec = vector;
-    prog->cached_lineno_pc = pc;
-    prog->cached_lineno = lineno;
     return lineno;
 }
 
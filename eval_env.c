@@ -17,29 +17,110 @@
 
 #include "eval_env.h"
 
+#include "list.h"
 #include "storage.h"
 #include "structures.h"
 #include "sym_table.h"
 #include "utils.h"
 
+static int
+var_pool_class(const Var_Pool * pool, unsigned size)
+{
+    int c;
+
+    for (c = 0; c < VAR_POOL_CLASSES; c++)
+	if (size <= pool->base << c)
+	    return c;
+
+    return -1;
+}
+
+Var *
+pool_alloc_vars(Var_Pool * pool, unsigned size)
+{
+    int c = var_pool_class(pool, size);
+    Var *ret;
+
+    if (c < 0) {
+	pool->unpooled++;
+	return mymalloc(size * sizeof(Var), pool->type);
+    }
+    if (pool->free[c]) {
+	ret = pool->free[c];
+	pool->free[c] = ret[0].v.list;
+	pool->nfree[c]--;
+	pool->hits[c]++;
+    } else {
+	ret = mymalloc((pool->base << c) * sizeof(Var), pool->type);
+	pool->misses[c]++;
+    }
+
+    return ret;
+}
+
+void
+pool_free_vars(Var_Pool * pool, Var * vars, unsigned size)
+{
+    int c = var_pool_class(pool, size);
+
+    if (c < 0 || pool->nfree[c] >= VAR_POOL_DEPTH)
+	myfree(vars, pool->type);
+    else {
+	vars[0].v.list = pool->free[c];
+	pool->free[c] = vars;
+	pool->nfree[c]++;
+    }
+}
+
+Var
+var_pool_stats(const Var_Pool * pool)
+{
+    Var r, classes;
+    int c;
+
+    classes = new_list(VAR_POOL_CLASSES);
+    for (c = 0; c < VAR_POOL_CLASSES; c++) {
+	Var v = new_list(4);
+
+	v.v.list[1].type = TYPE_INT;
+	v.v.list[1].v.num = pool->base << c;
+	v.v.list[2].type = TYPE_INT;
+	v.v.list[2].v.num = pool->nfree[c];
+	v.v.list[3].type = TYPE_INT;
+	v.v.list[3].v.num = pool->hits[c];
+	v.v.list[4].type = TYPE_INT;
+	v.v.list[4].v.num = pool->misses[c];
+	classes.v.list[c + 1] = v;
+    }
+
+    r = new_list(3);
+    r.v.list[1].type = TYPE_STR;
+    r.v.list[1].v.str = str_dup(pool->name);
+    r.v.list[2] = classes;
+    r.v.list[3].type = TYPE_INT;
+    r.v.list[3].v.num = pool->unpooled;
+    return r;
+}
+
 /*
- * Keep a pool of rt_envs big enough to hold NUM_READY_VARS variables to
- * avoid lots of malloc/free.
+ * Most verbs need no more than NUM_READY_VARS variables, built-ins
+ * included, but those that do shouldn't each go to malloc either.
  */
-static Var *ready_size_rt_envs;
+static Var_Pool rt_env_pool =
+    { .name = "rt_env", .base = NUM_READY_VARS, .type = M_RT_ENV };
+
+Var
+rt_env_pool_stats(void)
+{
+    return var_pool_stats(&rt_env_pool);
+}
 
 Var *
 new_rt_env(unsigned size)
 {
-    Var *ret;
+    Var *ret = pool_alloc_vars(&rt_env_pool, size);
     unsigned i;
 
-    if (size <= NUM_READY_VARS && ready_size_rt_envs) {
-	ret = ready_size_rt_envs;
-	ready_size_rt_envs = ret[0].v.list;
-    } else
-	ret = mymalloc(MAX(size, NUM_READY_VARS) * sizeof(Var), M_RT_ENV);
-
     for (i = 0; i < size; i++)
 	ret[i].type = TYPE_NONE;
 
@@ -54,11 +135,7 @@ free_rt_env(Var * rt_env, unsigned size)
     for (i = 0; i < size; i++)
 	free_var(rt_env[i]);
 
-    if (size <= NUM_READY_VARS) {
-	rt_env[0].v.list = ready_size_rt_envs;
-	ready_size_rt_envs = rt_env;
-    } else
-	myfree((void *) rt_env, M_RT_ENV);
+    pool_free_vars(&rt_env_pool, rt_env, size);
 }
 
 Var *
@@ -20,9 +20,40 @@
 
 #include "config.h"
 
+#include "storage.h"
 #include "structures.h"
 #include "version.h"
 
+/*
+ * A pool of Var arrays, in VAR_POOL_CLASSES size classes that double from
+ * `base', so that the rt_envs and rt_stacks of verb calls only rarely have
+ * to come from malloc.  Each class keeps at most VAR_POOL_DEPTH arrays on
+ * its free list; anything larger than the largest class is not pooled.
+ */
+#define VAR_POOL_CLASSES	4
+#define VAR_POOL_DEPTH		64
+
+typedef struct Var_Pool {
+    const char *name;
+    unsigned base;
+    Memory_Type type;
+    Var *free[VAR_POOL_CLASSES];
+    unsigned nfree[VAR_POOL_CLASSES];
+    Num hits[VAR_POOL_CLASSES], misses[VAR_POOL_CLASSES];
+    Num unpooled;
+} Var_Pool;
+
+extern Var *pool_alloc_vars(Var_Pool *, unsigned size);
+extern void pool_free_vars(Var_Pool *, Var *, unsigned size);
+				/* SIZE must be the one the array was
+				 * allocated with.
+				 */
+extern Var var_pool_stats(const Var_Pool *);
+				/* {name, {{size, free, hits, misses}, ...},
+				 *  unpooled}
+				 */
+extern Var rt_env_pool_stats(void);
+
 extern Var *new_rt_env(unsigned size);
 extern void free_rt_env(Var * rt_env, unsigned size);
 extern Var *copy_rt_env(Var * from, unsigned size);
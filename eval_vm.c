@@ -28,15 +28,48 @@
 #include "structures.h"
 #include "tasks.h"
 
+/*
+ * Every suspend(), read() and resumption allocates and frees a vm, so keep
+ * a few around, activation array and all, in classes by stack depth that
+ * double from VM_POOL_BASE.  A vm's top_activ_stack never changes once it
+ * is set, so free_vm() can tell which class it came from.
+ */
+#define VM_POOL_BASE	4u
+#define VM_POOL_CLASSES	4
+#define VM_POOL_DEPTH	64
+
+static vm vm_pool[VM_POOL_CLASSES][VM_POOL_DEPTH];
+static unsigned vm_pool_count[VM_POOL_CLASSES];
+
+static int
+vm_pool_class(unsigned stack_size)
+{
+    int c;
+
+    for (c = 0; c < VM_POOL_CLASSES; c++)
+	if (stack_size <= VM_POOL_BASE << c)
+	    return c;
+
+    return -1;
+}
+
 /**** external functions ****/
 
 vm
 new_vm(TaskID task_id, int stack_size)
 {
-    vm the_vm = mymalloc(sizeof(vmstruct), M_VM);
+    int c = vm_pool_class(stack_size);
+    vm the_vm;
 
+    if (c >= 0 && vm_pool_count[c] > 0)
+	the_vm = vm_pool[c][--vm_pool_count[c]];
+    else {
+	the_vm = mymalloc(sizeof(vmstruct), M_VM);
+	if (c >= 0)
+	    stack_size = VM_POOL_BASE << c;
+	the_vm->activ_stack = mymalloc(sizeof(activation) * stack_size, M_VM);
+    }
     the_vm->task_id = task_id;
-    the_vm->activ_stack = mymalloc(sizeof(activation) * stack_size, M_VM);
 
     return the_vm;
 }
@@ -44,13 +77,19 @@ new_vm(TaskID task_id, int stack_size)
 void
 free_vm(vm the_vm, int stack_too)
 {
+    int c = vm_pool_class(the_vm->top_activ_stack + 1);
     int i;
 
     if (stack_too)
 	for (i = the_vm->top_activ_stack; i >= 0; i--)
 	    free_activation(&the_vm->activ_stack[i], 1);
-    myfree(the_vm->activ_stack, M_VM);
-    myfree(the_vm, M_VM);
+
+    if (c >= 0 && vm_pool_count[c] < VM_POOL_DEPTH)
+	vm_pool[c][vm_pool_count[c]++] = the_vm;
+    else {
+	myfree(the_vm->activ_stack, M_VM);
+	myfree(the_vm, M_VM);
+    }
 }
 
 activation
@@ -35,6 +35,8 @@
 #include "numbers.h"
 #include "opcode.h"
 #include "parse_cmd.h"
+#include "parser.h"
+#include "profile.h"
 #include "server.h"
 #include "storage.h"
 #include "streams.h"
@@ -61,6 +63,7 @@ static Num root_activ_vector;	/* root_activ_vector == MAIN_VECTOR
 /* these globals are not part of the vm because they get re-initialized
    after a suspend */
 static int ticks_remaining;
+static int profile_countdown;	/* ticks until next profile sample */
 int task_timed_out;
 static int interpreter_is_running = 0;
 static Timer_ID task_alarm_id;
@@ -108,22 +111,16 @@ typedef enum {
  * malloc.  This doesn't really need tuning.  Most rt_stacks will be less
  * than size 10.  I rounded up to a size which won't waste a lot of space
  * with a powers-of-two malloc (while leaving some room for mymalloc
- * overhead, if any).
+ * overhead, if any); the larger classes double from there.
  */
-static Var *rt_stack_quick;
-#define RT_STACK_QUICKSIZE	15
+static Var_Pool rt_stack_pool =
+    { .name = "rt_stack", .base = 15, .type = M_RT_STACK };
 
 static void
 alloc_rt_stack(activation * a, Num size)
 {
-    Var *res;
+    Var *res = pool_alloc_vars(&rt_stack_pool, size);
 
-    if (size <= RT_STACK_QUICKSIZE && rt_stack_quick) {
-	res = rt_stack_quick;
-	rt_stack_quick = rt_stack_quick[0].v.list;
-    } else {
-	res = mymalloc(MAX(size, RT_STACK_QUICKSIZE) * sizeof(Var), M_RT_STACK);
-    }
     a->base_rt_stack = a->top_rt_stack = res;
     a->rt_stack_size = size;
 }
@@ -131,13 +128,7 @@ alloc_rt_stack(activation * a, Num size)
 static void
 free_rt_stack(activation * a)
 {
-    Var *stack = a->base_rt_stack;
-
-    if (a->rt_stack_size <= RT_STACK_QUICKSIZE) {
-	stack[0].v.list = rt_stack_quick;
-	rt_stack_quick = stack;
-    } else
-	myfree(stack, M_RT_STACK);
+    pool_free_vars(&rt_stack_pool, a->base_rt_stack, a->rt_stack_size);
 }
 
 void
@@ -595,7 +586,7 @@ free_activation(activation * ap, char data_too)
     free_program(ap->prog);
 
     if (data_too && ap->bi_func_pc && ap->bi_func_data)
-	free_data(ap->bi_func_data);
+	free_bi_func_data(ap->bi_func_data, ap->bi_func_id);
     /* else bi_func_state will be later freed by bi_function */
 }
 
@@ -675,6 +666,8 @@ call_verb2(Objid this, const char *vname
     RUN_ACTIV.verb = str_ref(vname);
     RUN_ACTIV.verbname = str_ref(db_verb_names(h));
     RUN_ACTIV.debug = (db_verb_flags(h) & VF_DEBUG);
+    if (profile_interval)
+	profile_call(RUN_ACTIV.vloc, RUN_ACTIV.verbname);
 
     alloc_rt_stack(&RUN_ACTIV, program->main_vector.max_stack);
     RUN_ACTIV.pc = 0;
@@ -766,6 +759,31 @@ rangeset_error(UNum max, size_t blen, size_t ilen, Num from, Num after)
 #define bi_prop_protected(prop, progr) ((!is_wizard(progr)) && server_flag_option_cached(prop))
 #endif				/* IGNORE_PROP_PROTECTED */
 
+static void
+take_profile_sample(void)
+{
+    static profile_frame *frames = 0;
+    static unsigned frames_size = 0;
+    unsigned t;
+
+    if (frames_size <= top_activ_stack) {
+	if (frames)
+	    myfree(frames, M_PROFILE);
+	frames_size = max_stack_size;
+	frames = mymalloc(frames_size * sizeof(profile_frame), M_PROFILE);
+    }
+    for (t = 0; t <= top_activ_stack; t++) {
+	frames[t].definer = activ_stack[t].vloc;
+	frames[t].verbname = activ_stack[t].verbname;
+	frames[t].line = find_line_number(activ_stack[t].prog,
+					  (t == 0 ? root_activ_vector
+					   : MAIN_VECTOR),
+					  activ_stack[t].error_pc);
+    }
+    profile_sample(frames, top_activ_stack + 1);
+    profile_countdown = profile_interval;
+}
+
 /**
   the main interpreter -- run()
   everything is just an entry point to it
@@ -864,6 +882,68 @@ do {								\
 
 #define JUMP(label)     (bv = bc.vector + label)
 
+/* Fast paths for arithmetic and comparison on two INTs or, when floats
+ * are unboxed, two FLOATs.  Each computes the result straight into the
+ * left operand's stack slot (neither operand needs freeing) and leaves
+ * the opcode's case with `break'.  For any other operands, or when OK is
+ * false or the result would be an error, it does nothing and the general
+ * code following it runs instead.
+ */
+#define BOTH_OPERANDS(t)	(TOP_RT_VALUE.type == (t)		\
+				 && NEXT_TOP_RT_VALUE.type == (t))
+
+#define FAST_INT_OP(op, ok)						\
+    if (BOTH_OPERANDS(TYPE_INT) && (ok)) {				\
+	rts--;								\
+	TOP_RT_VALUE.v.num = TOP_RT_VALUE.v.num op rts->v.num;		\
+	break;								\
+    }
+
+/* A comparison is nearly always followed by the test of an if, elseif,
+ * while or ?:, which can then be done at once, without another trip
+ * through the loop; its tick is charged here too, unless charging it
+ * would need any of the checks at the top of the loop.
+ */
+#define IS_TEST_OPCODE(o)	((o) == OP_IF || (o) == OP_EIF		\
+				 || (o) == OP_WHILE || (o) == OP_IF_QUES)
+
+#define FAST_INT_COMPARE(op)						\
+    if (BOTH_OPERANDS(TYPE_INT)) {					\
+	rts--;								\
+	TOP_RT_VALUE.v.num = TOP_RT_VALUE.v.num op rts->v.num;		\
+	if (IS_TEST_OPCODE(*bv) && ticks_remaining > 1			\
+	    && !task_timed_out && !profile_interval) {			\
+	    ticks_remaining--;						\
+	    error_bv = bv++;						\
+	    goto do_test;						\
+	}								\
+	break;								\
+    }
+
+#if !FLOATS_ARE_BOXED
+#define FAST_FLOAT_ARITH(op, ok)					\
+    if (BOTH_OPERANDS(TYPE_FLOAT) && (ok)) {				\
+	FlNum d = NEXT_TOP_RT_VALUE.v.fnum op TOP_RT_VALUE.v.fnum;	\
+									\
+	if (IS_REAL(d)) {						\
+	    rts--;							\
+	    TOP_RT_VALUE.v.fnum = d;					\
+	    break;							\
+	}								\
+    }
+
+#define FAST_FLOAT_COMPARE(op)						\
+    if (BOTH_OPERANDS(TYPE_FLOAT)) {					\
+	rts--;								\
+	TOP_RT_VALUE.v.num = TOP_RT_VALUE.v.fnum op rts->v.fnum;	\
+	TOP_RT_VALUE.type = TYPE_INT;					\
+	break;								\
+    }
+#else
+#define FAST_FLOAT_ARITH(op, ok)
+#define FAST_FLOAT_COMPARE(op)
+#endif
+
 /* end of major run() macros */
 
     LOAD_STATE_VARIABLES();
@@ -888,6 +968,10 @@ do {								\
 		abort_task(ABORT_SECONDS);
 		return OUTCOME_ABORTED;
 	    }
+	    if (profile_interval && --profile_countdown <= 0) {
+		STORE_STATE_VARIABLES();
+		take_profile_sample();
+	    }
 	}
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wswitch"
@@ -902,7 +986,8 @@ do {								\
 		Var cond;
 
 		cond = POP();
-		if (!is_true(cond)) {	/* jump if false */
+		if (cond.type == TYPE_INT
+		    ? !cond.v.num : !is_true(cond)) {	/* jump if false */
 		    unsigned lab = READ_BYTES(bv, bc.numbytes_label);
 		    JUMP(lab);
 		}
@@ -1169,7 +1254,12 @@ do {								\
 	    break;
 
 	case OP_EQ:
+	    FAST_INT_COMPARE(==);
+	    FAST_FLOAT_COMPARE(==);
+	    /* fall through */
 	case OP_NE:
+	    FAST_INT_COMPARE(!=);
+	    FAST_FLOAT_COMPARE(!=);
 	    {
 		Var rhs, lhs, ans;
 
@@ -1186,7 +1276,12 @@ do {								\
 	    break;
 
 	case OP_LE:
+	    FAST_INT_COMPARE(<=);
+	    FAST_FLOAT_COMPARE(<=);
+	    /* fall through */
 	case OP_GT:
+	    FAST_INT_COMPARE(>);
+	    FAST_FLOAT_COMPARE(>);
 	    {
 		Var a, b;
 		int not;
@@ -1197,7 +1292,12 @@ do {								\
 		goto finish_comparison;
 
 	    case OP_LT:
+		FAST_INT_COMPARE(<);
+		FAST_FLOAT_COMPARE(<);
+		/* fall through */
 	    case OP_GE:
+		FAST_INT_COMPARE(>=);
+		FAST_FLOAT_COMPARE(>=);
 		/* yes, these are supposed to be reversed */
 		a = POP();
 		b = POP();
@@ -1259,9 +1359,23 @@ do {								\
 	    break;
 
 	case OP_MULT:
+	    FAST_INT_OP(*, 1);
+	    FAST_FLOAT_ARITH(*, 1);
+	    goto arith_op;
+
 	case OP_MINUS:
+	    FAST_INT_OP(-, 1);
+	    FAST_FLOAT_ARITH(-, 1);
+	    goto arith_op;
+
 	case OP_DIV:
+	    FAST_INT_OP(/, TOP_RT_VALUE.v.num != 0);
+	    FAST_FLOAT_ARITH(/, TOP_RT_VALUE.v.fnum != 0.0);
+	    goto arith_op;
+
 	case OP_MOD:
+	    FAST_INT_OP(%, TOP_RT_VALUE.v.num != 0);
+	arith_op:
 	    {
 		Var lhs, rhs, ans;
 
@@ -1300,6 +1414,8 @@ do {								\
 	    break;
 
 	case OP_ADD:
+	    FAST_INT_OP(+, 1);
+	    FAST_FLOAT_ARITH(+, 1);
 	    {
 		Var rhs, lhs, ans;
 
@@ -1844,7 +1960,22 @@ do {								\
 		    package p;
 
 		    STORE_STATE_VARIABLES();
-		    p = call_bi_func(func_id, args, 1, RUN_ACTIV.progr, 0);
+		    if (profile_interval) {
+			profile_frame where;
+			uintmax_t start = timer_nsec();
+
+			where.definer = RUN_ACTIV.vloc;
+			where.verbname = str_ref(RUN_ACTIV.verbname);
+			where.line = find_line_number(RUN_ACTIV.prog,
+						      (top_activ_stack == 0
+						       ? root_activ_vector
+						       : MAIN_VECTOR),
+						      RUN_ACTIV.error_pc);
+			p = call_bi_func(func_id, args, 1, RUN_ACTIV.progr, 0);
+			profile_builtin(&where, timer_nsec() - start);
+			free_str(where.verbname);
+		    } else
+			p = call_bi_func(func_id, args, 1, RUN_ACTIV.progr, 0);
 		    LOAD_STATE_VARIABLES();
 
 		    switch (p.kind) {
@@ -2303,6 +2434,23 @@ do {								\
 	    {
 		Var value;
 		value = RUN_ACTIV.rt_env[PUSH_n_INDEX(op)];
+		/* `x = x + k' and `x = x - k' on an INT local, for small k,
+		 * update the variable in place, charging the two ticks the
+		 * arithmetic and the PUT would.
+		 */
+		if (value.type == TYPE_INT && IS_OPTIM_NUM_OPCODE(bv[0])
+		    && (bv[1] == OP_ADD || bv[1] == OP_MINUS)
+		    && bv[2] == OP_PUT + PUSH_n_INDEX(op) && bv[3] == OP_POP
+		    && ticks_remaining > 2 && !task_timed_out
+		    && !profile_interval) {
+		    Num k = OPCODE_TO_OPTIM_NUM(bv[0]);
+
+		    ticks_remaining -= 2;
+		    RUN_ACTIV.rt_env[PUSH_n_INDEX(op)].v.num
+			= bv[1] == OP_ADD ? value.v.num + k : value.v.num - k;
+		    bv += 4;
+		    break;
+		}
 		if (value.type == TYPE_NONE) {
 		    free_var(value);
 		    PUSH_ERROR(E_VARNF);
@@ -2461,6 +2609,8 @@ run_interpreter(char raise, enum error e,
     Var args;
 
     setup_task_execution_limits(is_fg);
+    if (profile_interval)
+	profile_task_started();
 
     /* handler_verb_* is garbage/unreferenced outside of run()
      * and this is the only place run() is called. */
@@ -2508,16 +2658,22 @@ caller(void)
     return RUN_ACTIV.this;	/* XXX waifs?! */
 }
 
+/* The activation stack is only ever grown, so that changing
+ * max_stack_depth back and forth doesn't reallocate it for every task.
+ */
 static void
 check_activ_stack_size(UNum max)
 {
-    if (max_stack_size != max) {
+    static UNum allocated = 0;
+
+    if (allocated < max) {
 	if (activ_stack)
 	    myfree(activ_stack, M_VM);
 
 	activ_stack = mymalloc(sizeof(activation) * max, M_VM);
-	max_stack_size = max;
+	allocated = max;
     }
+    max_stack_size = max;
 }
 
 static UNum
@@ -2557,6 +2713,9 @@ do_task(Program * prog, int which_vector, Var * result, int is_fg, int do_db_tra
     RUN_ACTIV.bi_func_pc = 0;
     RUN_ACTIV.temp.type = TYPE_NONE;
 
+    if (profile_interval)
+	profile_call(RUN_ACTIV.vloc, RUN_ACTIV.verbname);
+
     return run_interpreter(0, E_NONE, result, is_fg, do_db_tracebacks);
 }
 
@@ -2732,6 +2891,55 @@ setup_activ_for_eval(Program * prog)
     return 1;
 }
 
+/* this is called from long-running built-in functions that need to let
+ * other tasks run:  push an activation that does suspend(0) and then
+ * returns 1, after which the function is re-entered with whatever
+ * pc and data it passed to make_call_pack().  As with eval(), the
+ * function must cope with being called back with a false value if the
+ * task is killed or resumed with an error in the meantime.
+ */
+
+int
+setup_activ_for_yield(void)
+{
+    static Program *yield_program = 0;
+
+    if (!yield_program) {
+	Var code, errors;
+
+	code = new_list(1);
+	code.v.list[1].type = TYPE_STR;
+	code.v.list[1].v.str = str_dup("suspend(0); return 1;");
+	yield_program = parse_list_as_program(code, &errors);
+	if (!yield_program)
+	    panic("Can't create the yield program!");
+	free_var(code);
+	free_var(errors);
+    }
+    if (!setup_activ_for_eval(program_ref(yield_program))) {
+	free_program(yield_program);
+	return 0;
+    }
+    free_str(RUN_ACTIV.verbname);
+    RUN_ACTIV.verbname = str_dup("Yield from built-in function");
+    return 1;
+}
+
+/* Leave enough ticks for the yield activation itself to run. */
+#define YIELD_TICKS_RESERVE	10
+
+int
+charge_ticks(int ticks)
+{
+    ticks_remaining -= ticks;
+    if (ticks_remaining < YIELD_TICKS_RESERVE)
+	ticks_remaining = YIELD_TICKS_RESERVE;
+
+    return (ticks_remaining > YIELD_TICKS_RESERVE
+	    && !task_timed_out
+	    && timer_wakeup_interval(task_alarm_id) > 0);
+}
+
 /**** built in functions ****/
 
 struct cf_state {
@@ -2784,6 +2992,15 @@ bf_call_function_write(void *data)
     write_bi_func_data(s->data, s->fnum);
 }
 
+static void
+bf_call_function_free(void *data)
+{
+    struct cf_state *s = data;
+
+    free_bi_func_data(s->data, s->fnum);
+    free_data(s);
+}
+
 static void *
 bf_call_function_read(void)
 {
@@ -2903,6 +3120,24 @@ bf_ticks_left(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr U
     return make_var_pack(r);
 }
 
+/* pool_stats() => {{name, {{size, free, hits, misses}, ...}, unpooled}, ...}
+ * for the rt_env and rt_stack pools.
+ */
+static package
+bf_pool_stats(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr)
+{
+    Var r;
+
+    free_var(arglist);
+    if (!is_wizard(progr))
+	return make_error_pack(E_PERM);
+
+    r = new_list(2);
+    r.v.list[1] = rt_env_pool_stats();
+    r.v.list[2] = var_pool_stats(&rt_stack_pool);
+    return make_var_pack(r);
+}
+
 static package
 bf_pass(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSED_)
 {
@@ -2982,16 +3217,21 @@ bf_task_stack(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr)
 void
 register_execute(void)
 {
-    register_function_with_read_write("call_function", 1, -1, bf_call_function,
-				      bf_call_function_read,
-				      bf_call_function_write,
-				      TYPE_STR);
+    unsigned f;
+
+    f = register_function_with_read_write("call_function", 1, -1,
+					  bf_call_function,
+					  bf_call_function_read,
+					  bf_call_function_write,
+					  TYPE_STR);
+    register_function_free(f, bf_call_function_free);
     register_function("raise", 1, 3, bf_raise, TYPE_ANY, TYPE_STR, TYPE_ANY);
     register_function("suspend", 0, 1, bf_suspend, TYPE_INT);
     register_function("read", 0, 2, bf_read, TYPE_OBJ, TYPE_ANY);
 
     register_function("seconds_left", 0, 0, bf_seconds_left);
     register_function("ticks_left", 0, 0, bf_ticks_left);
+    register_function("pool_stats", 0, 0, bf_pool_stats);
     register_function("pass", 0, -1, bf_pass);
     register_function("set_task_perms", 1, 1, bf_set_task_perms, TYPE_OBJ);
     register_function("caller_perms", 0, 0, bf_caller_perms);
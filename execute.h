@@ -95,6 +95,16 @@ extern enum error call_verb2(Objid obj, const char *vname
 			     Var args, int do_pass);
 
 extern int setup_activ_for_eval(Program * prog);
+extern int setup_activ_for_yield(void);
+extern int charge_ticks(int ticks);
+				/* For built-in functions that do work in
+				 * chunks:  charge TICKS to the current task
+				 * and return true iff it has enough ticks and
+				 * seconds left to do another chunk.  If not,
+				 * the function should setup_activ_for_yield()
+				 * and return make_call_pack(), resuming its
+				 * work when it is re-entered.
+				 */
 
 enum outcome {
     OUTCOME_DONE,		/* Task ran successfully to completion */
@@ -0,0 +1,605 @@
+/*
+ * JSON for the MOO Server
+ */
+
+#include "bf_register.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include "my-ctype.h"
+#include "my-math.h"
+#include "my-string.h"
+
+#include "exceptions.h"
+#include "functions.h"
+#include "list.h"
+#include "server.h"
+#include "storage.h"
+#include "streams.h"
+#include "unparse.h"
+#include "utf.h"
+#include "utf-ctype.h"
+#include "utils.h"
+
+/*
+ *   JSON		MOO
+ *   ----		---
+ *   number		INT, or FLOAT if it has a fraction or exponent or
+ *			  is too large for an INT
+ *   string		STR
+ *   true, false	1, 0
+ *   null		0
+ *   array		LIST
+ *   object		LIST of E_NONE followed by {key, value} pairs:
+ *			  {"a": [1, 2]}  =  {E_NONE, {"a", {1, 2}}}
+ *
+ * generate_json() also accepts OBJ and ERR values, writing them as the
+ * strings "#17" and "E_PERM".
+ *
+ * JSON strings may hold characters that MOO strings cannot; parse_json()
+ * raises E_INVARG on those unless asked to return all strings as MOO
+ * binary strings (as xml_parse_tree() does).
+ */
+
+/* Nesting deeper than this is refused, since freeing or printing such a
+ * value recurses once per level.
+ */
+#define JSON_MAX_DEPTH		512
+
+#define VSIZE_INITIAL		32
+
+
+/*********** Parsing ***********/
+
+/*
+ * The parser is event-driven rather than recursive:  finished values
+ * pile up on VALUES, and closing a container gathers its elements off
+ * the top of that stack into a single new list, so every value is copied
+ * just once however large or deeply nested the text.
+ */
+
+typedef struct {
+    char close;			/* ']' or '}' */
+    UNum first;			/* index of its first element in VALUES */
+} JSONcontainer;
+
+typedef struct {
+    const char *start;
+    const char *p;		/* next unparsed byte */
+    int binary;
+    Var values;			/* LIST of values not yet collected */
+    size_t vsize;		/* allocated size of values */
+    Stream *s;			/* place to collect string contents */
+    JSONcontainer *stack;
+    int depth;
+} JSONparser;
+
+#define VALUES_TOP(j)  ((j)->values.v.list[0].v.num)
+
+static void
+init_parser(JSONparser *j, const char *text, int binary)
+{
+    j->start = j->p = text;
+    j->binary = binary;
+    j->values = new_list(VSIZE_INITIAL - 1);
+    j->vsize = VSIZE_INITIAL;
+    VALUES_TOP(j) = 0;
+    j->s = new_stream(100);
+    j->stack = mymalloc(JSON_MAX_DEPTH * sizeof(JSONcontainer), M_JSON_DATA);
+    j->depth = 0;
+}
+
+static void
+free_parser(JSONparser *j)
+{
+    free_var(j->values);
+    free_stream(j->s);
+    myfree(j->stack, M_JSON_DATA);
+}
+
+/* Returns a slot on top of VALUES, which the caller must fill before
+ * anything else can raise stream_too_big.  Raises stream_too_big itself
+ * if MAX_LIST_CONCAT would be exceeded.
+ */
+static Var *
+new_value_slot(JSONparser *j)
+{
+    if ((UNum) (VALUES_TOP(j) + 1) >= j->vsize) {
+	size_t vmaxsize = 1 + server_int_option_cached(SVO_MAX_LIST_CONCAT);
+
+	if (j->vsize >= vmaxsize)
+	    RAISE(stream_too_big, 1);
+	if ((j->vsize *= 2) >= vmaxsize)
+	    j->vsize = vmaxsize;
+	j->values.v.list = myrealloc(j->values.v.list,
+				     j->vsize * sizeof(Var), M_LIST);
+    }
+    return &j->values.v.list[++VALUES_TOP(j)];
+}
+
+/* Replaces VALUES[FIRST..TOP] with a single array or object. */
+static void
+collect_container(JSONparser *j, UNum first, int is_object)
+{
+    Num n = VALUES_TOP(j) + 1 - first;
+    Var *v = j->values.v.list + first;
+    Var r;
+    Num i;
+
+    if (!is_object) {
+	r = new_list(n);
+	memcpy(r.v.list + 1, v, n * sizeof(Var));
+    } else {
+	r = new_list(n / 2 + 1);
+	r.v.list[1].type = TYPE_ERR;
+	r.v.list[1].v.err = E_NONE;
+	for (i = 0; i < n / 2; i++) {
+	    Var pair = new_list(2);
+
+	    pair.v.list[1] = v[2 * i];
+	    pair.v.list[2] = v[2 * i + 1];
+	    r.v.list[i + 2] = pair;
+	}
+    }
+    VALUES_TOP(j) = first - 1;
+    *new_value_slot(j) = r;	/* cannot raise; we just freed N slots */
+}
+
+static void
+skip_whitespace(JSONparser *j)
+{
+    while (*j->p == ' ' || *j->p == '\t' || *j->p == '\n' || *j->p == '\r')
+	j->p++;
+}
+
+static int
+encode_utf8(uint32_t c, char *buf)
+{
+    if (c < 0x80) {
+	buf[0] = c;
+	return 1;
+    } else if (c < 0x800) {
+	buf[0] = 0xC0 | (c >> 6);
+	buf[1] = 0x80 | (c & 0x3F);
+	return 2;
+    } else if (c < 0x10000) {
+	buf[0] = 0xE0 | (c >> 12);
+	buf[1] = 0x80 | ((c >> 6) & 0x3F);
+	buf[2] = 0x80 | (c & 0x3F);
+	return 3;
+    } else {
+	buf[0] = 0xF0 | (c >> 18);
+	buf[1] = 0x80 | ((c >> 12) & 0x3F);
+	buf[2] = 0x80 | ((c >> 6) & 0x3F);
+	buf[3] = 0x80 | (c & 0x3F);
+	return 4;
+    }
+}
+
+static const char *
+add_escaped_char(JSONparser *j, uint32_t c)
+{
+    if (j->binary) {
+	char buf[4];
+
+	stream_add_moobinary_from_raw_bytes(j->s, buf, encode_utf8(c, buf));
+    } else if (!my_is_printable(c))
+	return "character not allowed in MOO strings";
+    else
+	stream_add_utf(j->s, c);
+    return 0;
+}
+
+static int
+parse_hex4(const char *p, uint32_t *c)
+{
+    int i;
+
+    *c = 0;
+    for (i = 0; i < 4; i++, p++) {
+	if (!isxdigit((unsigned char) *p))
+	    return 0;
+	*c = (*c << 4) + (isdigit((unsigned char) *p)
+			  ? *p - '0'
+			  : (*p | 0x20) - 'a' + 10);
+    }
+    return 1;
+}
+
+/* Parses the string at j->p into j->s; returns an error message or 0. */
+static const char *
+parse_string(JSONparser *j)
+{
+    const char *p = j->p + 1, *run, *error;
+    uint32_t c, c2;
+
+    reset_stream(j->s);
+    for (;;) {
+	for (run = p; *p != '"' && *p != '\\'; p++)
+	    if ((unsigned char) *p < 0x20) {
+		j->p = p;
+		return *p ? "control character in string"
+			  : "unterminated string";
+	    }
+	if (j->binary)
+	    stream_add_moobinary_from_raw_bytes(j->s, run, p - run);
+	else
+	    stream_add_bytes(j->s, run, p - run);
+	if (*p++ == '"')
+	    break;
+
+	switch (*p++) {
+	case '"':  c = '"';  break;
+	case '\\': c = '\\'; break;
+	case '/':  c = '/';  break;
+	case 'b':  c = '\b'; break;
+	case 'f':  c = '\f'; break;
+	case 'n':  c = '\n'; break;
+	case 'r':  c = '\r'; break;
+	case 't':  c = '\t'; break;
+	case 'u':
+	    if (!parse_hex4(p, &c)) {
+		j->p = p;
+		return "bad \\u escape";
+	    }
+	    p += 4;
+	    if (c >= 0xDC00 && c <= 0xDFFF) {
+		j->p = p - 6;
+		return "unpaired surrogate";
+	    }
+	    if (c >= 0xD800 && c <= 0xDBFF) {
+		if (p[0] != '\\' || p[1] != 'u' || !parse_hex4(p + 2, &c2)
+		    || c2 < 0xDC00 || c2 > 0xDFFF) {
+		    j->p = p - 6;
+		    return "unpaired surrogate";
+		}
+		c = 0x10000 + ((c - 0xD800) << 10) + (c2 - 0xDC00);
+		p += 6;
+	    }
+	    break;
+	default:
+	    j->p = p - 2;
+	    return "bad escape";
+	}
+	if ((error = add_escaped_char(j, c)) != 0) {
+	    j->p = p;
+	    return error;
+	}
+    }
+    j->p = p;
+    return 0;
+}
+
+/* Parses the number at j->p onto VALUES; returns an error message or 0. */
+static const char *
+parse_number(JSONparser *j)
+{
+    const char *p = j->p;
+    int is_float = 0;
+    intmax_t n = 0;
+    FlNum d = 0.0;
+    Var *v;
+
+    if (*p == '-')
+	p++;
+    if (*p == '0')
+	p++;
+    else if (isdigit((unsigned char) *p))
+	while (isdigit((unsigned char) *p))
+	    p++;
+    else
+	return "unexpected character";
+    if (*p == '.') {
+	if (!isdigit((unsigned char) *++p))
+	    return "bad number";
+	while (isdigit((unsigned char) *p))
+	    p++;
+	is_float = 1;
+    }
+    if (*p == 'e' || *p == 'E') {
+	if (*++p == '+' || *p == '-')
+	    p++;
+	if (!isdigit((unsigned char) *p))
+	    return "bad number";
+	while (isdigit((unsigned char) *p))
+	    p++;
+	is_float = 1;
+    }
+
+    if (!is_float) {
+	errno = 0;
+	n = strtoimax(j->p, 0, 10);
+	if (errno == ERANGE || n < NUM_MIN || n > NUM_MAX)
+	    is_float = 1;
+    }
+    if (is_float) {
+	d = strtoflnum(j->p, 0);
+	if (!IS_REAL(d))
+	    return "number out of range";
+    }
+    j->p = p;
+
+    v = new_value_slot(j);
+    if (is_float) {
+	v->type = TYPE_FLOAT;
+	v->v.fnum = box_fl(d);
+    } else {
+	v->type = TYPE_INT;
+	v->v.num = n;
+    }
+    return 0;
+}
+
+/* Pushes the string collected by parse_string() onto VALUES. */
+static void
+push_string(JSONparser *j)
+{
+    Var *v = new_value_slot(j);
+
+    v->type = TYPE_STR;
+    v->v.str = str_dup(stream_contents(j->s));
+}
+
+/* Parses an object key and the following colon. */
+static const char *
+parse_key(JSONparser *j)
+{
+    const char *error;
+
+    skip_whitespace(j);
+    if (*j->p != '"')
+	return "expected a string";
+    if ((error = parse_string(j)) != 0)
+	return error;
+    push_string(j);
+
+    skip_whitespace(j);
+    if (*j->p != ':')
+	return "expected `:'";
+    j->p++;
+    return 0;
+}
+
+static const char *
+parse_text(JSONparser *j)
+{
+    const char *error;
+    Var v;
+
+    for (;;) {
+	/* Parse a value, or begin a container. */
+	skip_whitespace(j);
+	switch (*j->p) {
+	case '[':
+	case '{':
+	    if (j->depth == JSON_MAX_DEPTH)
+		return "nesting too deep";
+	    j->stack[j->depth].close = *j->p == '[' ? ']' : '}';
+	    j->stack[j->depth].first = VALUES_TOP(j) + 1;
+	    j->depth++;
+	    j->p++;
+	    skip_whitespace(j);
+	    if (*j->p == j->stack[j->depth - 1].close)
+		break;		/* empty; closed below */
+	    if (j->stack[j->depth - 1].close == '}'
+		&& (error = parse_key(j)) != 0)
+		return error;
+	    continue;
+	case '"':
+	    if ((error = parse_string(j)) != 0)
+		return error;
+	    push_string(j);
+	    break;
+	case 't':
+	case 'f':
+	case 'n':
+	    if (!strncmp(j->p, "true", 4))
+		v.v.num = 1, j->p += 4;
+	    else if (!strncmp(j->p, "false", 5))
+		v.v.num = 0, j->p += 5;
+	    else if (!strncmp(j->p, "null", 4))
+		v.v.num = 0, j->p += 4;
+	    else
+		return "unexpected character";
+	    v.type = TYPE_INT;
+	    *new_value_slot(j) = v;
+	    break;
+	default:
+	    if (*j->p == '\0')
+		return "unexpected end of text";
+	    if ((error = parse_number(j)) != 0)
+		return error;
+	    break;
+	}
+
+	/* A value is done; close containers or move on to the next one. */
+	for (;;) {
+	    JSONcontainer *c;
+
+	    skip_whitespace(j);
+	    if (j->depth == 0)
+		return *j->p ? "text after the end of the value" : 0;
+	    c = &j->stack[j->depth - 1];
+	    if (*j->p == c->close) {
+		j->p++;
+		j->depth--;
+		collect_container(j, c->first, c->close == '}');
+	    } else if (*j->p == ',') {
+		j->p++;
+		if (c->close == '}' && (error = parse_key(j)) != 0)
+		    return error;
+		break;
+	    } else
+		return (c->close == ']'
+			? "expected `,' or `]'"
+			: "expected `,' or `}'");
+	}
+    }
+}
+
+static package
+parse_json(const char *text, int binary)
+{
+    JSONparser j;
+    package result;
+    const char *error = 0;
+
+    init_parser(&j, text, binary);
+    TRY_STREAM {
+	error = parse_text(&j);
+	if (!error) {
+	    result = make_var_pack(j.values.v.list[1]);
+	    VALUES_TOP(&j) = 0;
+	} else {
+	    Var r;
+
+	    r.type = TYPE_INT;
+	    r.v.num = j.p - j.start;
+	    result = make_raise_pack(E_INVARG, error, r);
+	}
+    }
+    EXCEPT (stream_too_big) {
+	result = make_space_pack();
+    }
+    ENDTRY_STREAM;
+    free_parser(&j);
+    return result;
+}
+
+
+/*********** Generation ***********/
+
+static void
+generate_string(Stream *s, const char *str)
+{
+    const char *run;
+
+    stream_add_char(s, '"');
+    for (;;) {
+	for (run = str;
+	     *str && *str != '"' && *str != '\\'
+		 && (unsigned char) *str >= 0x20 && *str != 0x7F;
+	     str++)
+	    ;
+	stream_add_bytes(s, run, str - run);
+	switch (*str) {
+	case '\0':
+	    stream_add_char(s, '"');
+	    return;
+	case '"':
+	case '\\':
+	    stream_add_char(s, '\\');
+	    stream_add_char(s, *str);
+	    break;
+	case '\t':
+	    stream_add_string(s, "\\t");
+	    break;
+	default:
+	    stream_printf(s, "\\u%04x", (unsigned char) *str);
+	    break;
+	}
+	str++;
+    }
+}
+
+static enum error
+generate(Stream *s, Var v, int depth)
+{
+    enum error e;
+    int i;
+
+    switch (v.type) {
+    case TYPE_INT:
+	stream_printf(s, "%"PRIdN, v.v.num);
+	break;
+    case TYPE_FLOAT:
+	stream_unparse_float(s, fl_unbox(v.v.fnum), 0);
+	break;
+    case TYPE_OBJ:
+	stream_printf(s, "\"#%"PRIdN"\"", v.v.obj);
+	break;
+    case TYPE_ERR:
+	stream_printf(s, "\"%s\"", error_name(v.v.err));
+	break;
+    case TYPE_STR:
+	generate_string(s, v.v.str);
+	break;
+    case TYPE_LIST:
+	if (depth >= JSON_MAX_DEPTH)
+	    return E_INVARG;
+	if (v.v.list[0].v.num >= 1
+	    && v.v.list[1].type == TYPE_ERR && v.v.list[1].v.err == E_NONE) {
+	    stream_add_char(s, '{');
+	    for (i = 2; i <= v.v.list[0].v.num; i++) {
+		Var pair = v.v.list[i];
+
+		if (pair.type != TYPE_LIST || pair.v.list[0].v.num != 2
+		    || pair.v.list[1].type != TYPE_STR)
+		    return E_INVARG;
+		if (i > 2)
+		    stream_add_char(s, ',');
+		generate_string(s, pair.v.list[1].v.str);
+		stream_add_char(s, ':');
+		if ((e = generate(s, pair.v.list[2], depth + 1)) != E_NONE)
+		    return e;
+	    }
+	    stream_add_char(s, '}');
+	} else {
+	    stream_add_char(s, '[');
+	    for (i = 1; i <= v.v.list[0].v.num; i++) {
+		if (i > 1)
+		    stream_add_char(s, ',');
+		if ((e = generate(s, v.v.list[i], depth + 1)) != E_NONE)
+		    return e;
+	    }
+	    stream_add_char(s, ']');
+	}
+	break;
+    default:
+	return E_TYPE;
+    }
+    return E_NONE;
+}
+
+
+/*********** Built-in functions ***********/
+
+static package
+bf_generate_json(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSED_)
+{				/* (value) */
+    package p;
+    Stream *volatile s = new_stream(100);
+
+    TRY_STREAM {
+	enum error e = generate(s, arglist.v.list[1], 0);
+
+	if (e == E_NONE)
+	    p = make_string_pack(str_dup(stream_contents(s)));
+	else
+	    p = make_error_pack(e);
+    }
+    EXCEPT (stream_too_big) {
+	p = make_space_pack();
+    }
+    ENDTRY_STREAM;
+    free_stream(s);
+    free_var(arglist);
+    return p;
+}
+
+static package
+bf_parse_json(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSED_)
+{				/* (text [, binary]) */
+    int binary = arglist.v.list[0].v.num >= 2 && is_true(arglist.v.list[2]);
+    package result = parse_json(arglist.v.list[1].v.str, binary);
+
+    free_var(arglist);
+    return result;
+}
+
+void
+register_json(void)
+{
+    register_function("generate_json", 1, 1, bf_generate_json, TYPE_ANY);
+    register_function("parse_json", 1, 2, bf_parse_json, TYPE_STR, TYPE_ANY);
+}
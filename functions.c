@@ -29,6 +29,7 @@
 #include "streams.h"
 #include "structures.h"
 #include "tasks.h"
+#include "timers.h"
 #include "unparse.h"
 #include "utils.h"
 #include "waif.h"
@@ -50,12 +51,30 @@ struct bft_entry {
     bf_type func;
     bf_read_type read;
     bf_write_type write;
+    bf_free_type free;
     int protected;
 };
 
 static struct bft_entry bf_table[MAX_FUNC];
 static unsigned top_bf_table = 0;
 
+/* Per-function statistics, only gathered while the `function_stats'
+ * server option is set.  Calls are counted on first entry; time and
+ * allocation include every re-entry (e.g., after a verb call made on
+ * the function's behalf).  hist[i] counts entries that took less than
+ * 2^i microseconds, except the last, which counts all the rest.
+ */
+#define BF_HIST_BUCKETS 16
+
+struct bf_stats {
+    Num calls;
+    uintmax_t nsec;
+    uintmax_t bytes;
+    Num hist[BF_HIST_BUCKETS];
+};
+
+static struct bf_stats bf_stats[MAX_FUNC];
+
 static unsigned
 register_common(const char *name, int minargs, int maxargs, bf_type func,
 		bf_read_type read, bf_write_type write, va_list args)
@@ -80,6 +99,7 @@ register_common(const char *name, int minargs, int maxargs, bf_type func,
     bf_table[top_bf_table].func = func;
     bf_table[top_bf_table].read = read;
     bf_table[top_bf_table].write = write;
+    bf_table[top_bf_table].free = 0;
     bf_table[top_bf_table].protected = 0;
 
     if (num_arg_types > 0)
@@ -120,6 +140,13 @@ register_function_with_read_write(const char *name, int minargs, int maxargs,
     return ans;
 }
 
+void
+register_function_free(unsigned f_id, bf_free_type free)
+{
+    if (f_id < top_bf_table)
+	bf_table[f_id].free = free;
+}
+
 /*** looking up functions -- by name or num ***/
 
 static const char *func_not_found_msg = "no such function";
@@ -220,8 +247,28 @@ call_bi_func(unsigned n, Var arglist, Byte func_pc,
     /*
      * do the function
      */
-    return (*(f->func)) (arglist, func_pc, vdata, progr);
     /* f->func is responsible for freeing/using up arglist. */
+    if (!server_flag_option_cached(SVO_FUNCTION_STATS))
+	return (*(f->func)) (arglist, func_pc, vdata, progr);
+
+    {
+	struct bf_stats *st = bf_stats + n;
+	uintmax_t start = timer_nsec(), bytes = bytes_allocated, elapsed;
+	package p;
+	int b;
+
+	p = (*(f->func)) (arglist, func_pc, vdata, progr);
+
+	elapsed = timer_nsec() - start;
+	st->nsec += elapsed;
+	st->bytes += bytes_allocated - bytes;
+	if (func_pc == 1)
+	    st->calls++;
+	for (elapsed /= 1000, b = 0; elapsed && b < BF_HIST_BUCKETS - 1; b++)
+	    elapsed >>= 1;
+	st->hist[b]++;
+	return p;
+    }
 }
 
 void
@@ -233,6 +280,15 @@ write_bi_func_data(void *vdata, Byte f_id)
 	(*(bf_table[f_id].write)) (vdata);
 }
 
+void
+free_bi_func_data(void *vdata, Byte f_id)
+{
+    if (f_id < top_bf_table && bf_table[f_id].free)
+	(*(bf_table[f_id].free)) (vdata);
+    else
+	free_data(vdata);
+}
+
 static Byte *pc_for_bi_func_data_being_read;
 
 Byte *
@@ -445,6 +501,73 @@ bf_function_info(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid prog
     return make_var_pack(r);
 }
 
+static Var
+function_stats(int i)
+{
+    struct bf_stats *st = bf_stats + i;
+    Var v, h;
+    int j;
+
+    v = new_list(5);
+    v.v.list[1].type = TYPE_STR;
+    v.v.list[1].v.str = str_ref(bf_table[i].name);
+    v.v.list[2].type = TYPE_INT;
+    v.v.list[2].v.num = st->calls;
+    v.v.list[3].type = TYPE_INT;
+    v.v.list[3].v.num = st->nsec;
+    v.v.list[4].type = TYPE_INT;
+    v.v.list[4].v.num = st->bytes;
+    h = v.v.list[5] = new_list(BF_HIST_BUCKETS);
+    for (j = 0; j < BF_HIST_BUCKETS; j++) {
+	h.v.list[j + 1].type = TYPE_INT;
+	h.v.list[j + 1].v.num = st->hist[j];
+    }
+    return v;
+}
+
+/* function_stats([name]) => {name, calls, nsec, bytes, histogram}
+ * for the named function, or a list of those for every function that
+ * has been called since the last reset_function_stats().
+ */
+static package
+bf_function_stats(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr)
+{
+    Var r;
+    unsigned i;
+
+    if (!is_wizard(progr)) {
+	free_var(arglist);
+	return make_error_pack(E_PERM);
+    }
+    if (arglist.v.list[0].v.num == 1) {
+	i = number_func_by_name(arglist.v.list[1].v.str);
+	if (i == FUNC_NOT_FOUND) {
+	    free_var(arglist);
+	    return make_error_pack(E_INVARG);
+	}
+	r = function_stats(i);
+    } else {
+	r = new_list(0);
+	for (i = 0; i < top_bf_table; i++)
+	    if (bf_stats[i].calls || bf_stats[i].nsec)
+		r = listappend(r, function_stats(i));
+    }
+
+    free_var(arglist);
+    return make_var_pack(r);
+}
+
+static package
+bf_reset_function_stats(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr)
+{
+    free_var(arglist);
+    if (!is_wizard(progr))
+	return make_error_pack(E_PERM);
+
+    memset(bf_stats, 0, sizeof(bf_stats));
+    return no_var_pack();
+}
+
 static void
 load_server_protect_function_flags(void)
 {
@@ -513,6 +636,8 @@ register_functions(void)
 			   "loading server options");
 
     register_function("function_info", 0, 1, bf_function_info, TYPE_STR);
+    register_function("function_stats", 0, 1, bf_function_stats, TYPE_STR);
+    register_function("reset_function_stats", 0, 0, bf_reset_function_stats);
     register_function("load_server_options", 0, 0, bf_load_server_options);
 }
 
@@ -83,6 +83,7 @@ package make_space_pack(void);
 typedef package(*bf_type) (Var, Byte, void *, Objid);
 typedef void (*bf_write_type) (void *vdata);
 typedef void *(*bf_read_type) (void);
+typedef void (*bf_free_type) (void *vdata);
 
 #define MAX_FUNC         256
 #define FUNC_NOT_FOUND   MAX_FUNC
@@ -98,6 +99,12 @@ extern unsigned register_function(const char *, int, int, bf_type,...);
 extern unsigned register_function_with_read_write(const char *, int, int,
 						  bf_type, bf_read_type,
 						  bf_write_type,...);
+extern void register_function_free(unsigned, bf_free_type);
+				/* Sets the function used to free the data a
+				 * built-in passed to make_call_pack() when its
+				 * task is killed before it is called back;
+				 * by default that data is just free_data()'d.
+				 */
 
 /*--------------*
  |  invocation  |
@@ -114,6 +121,7 @@ extern void write_bi_func_data(void *vdata, Byte f_id);
 extern int read_bi_func_data(Byte f_id, void **bi_func_state,
 			     Byte * bi_func_pc);
 extern Byte *pc_for_bi_func_data(void);
+extern void free_bi_func_data(void *vdata, Byte f_id);
 
 /*--------------*
  |  protection  |
@@ -25,14 +25,18 @@
 #include "my-string.h"
 #include "my-math.h"
 
+#include "db_io.h"
 #include "exceptions.h"
+#include "execute.h"
 #include "functions.h"
 #include "log.h"
+#include "numbers.h"
 #include "md5.h"
 #include "pattern.h"
 #include "random.h"
 #include "ref_count.h"
 #include "server.h"
+#include "sha256.h"
 #include "streams.h"
 #include "storage.h"
 #include "structures.h"
@@ -90,11 +94,151 @@ setremove(Var list, Var value)
     }
 }
 
+/*
+ * Membership tests on long lists are answered from a transient hash index.
+ * An index is keyed by the list's storage and holds no reference to it;
+ * it is dropped whenever that storage is modified in place or freed.  A
+ * list is only indexed the second time it is searched, so that a list
+ * searched just once (as by a chain of setadd()s, each of which makes a
+ * new list) never pays for building one.
+ */
+
+#define LIST_INDEX_MIN_LENGTH	32
+#define LIST_INDEX_SLOTS	64	/* must be a power of two */
+
+typedef struct {
+    Var *list;			/* storage searched, or 0 if slot unused */
+    int *buckets;		/* first index in each bucket; 0 until built */
+    int *chain;			/* next index in the same bucket */
+    unsigned mask;
+} List_Index;
+
+static List_Index list_indexes[LIST_INDEX_SLOTS];
+int list_indexes_in_use = 0;
+
+static inline List_Index *
+list_index_slot(const Var *list)
+{
+    return &list_indexes[((uintptr_t) list >> 4) & (LIST_INDEX_SLOTS - 1)];
+}
+
+static unsigned
+hash_num(Num n)
+{
+    uint64_t x = (uint64_t) n * UINT64_C(0x9e3779b97f4a7c15);
+
+    return (unsigned) (x >> 32);
+}
+
+/* Values that are equality()-equal, with or without case mattering, must
+ * hash the same; integral floats therefore hash as the equivalent integer.
+ */
+static unsigned
+index_hash(Var v)
+{
+    switch (v.type) {
+    case TYPE_INT:
+	return hash_num(v.v.num);
+    case TYPE_OBJ:
+	return hash_num(v.v.obj) ^ 1;
+    case TYPE_ERR:
+	return hash_num(v.v.err) ^ 2;
+    case TYPE_STR:
+	return str_hash(v.v.str);
+    case TYPE_FLOAT:
+	{
+	    FlNum f = fl_unbox(v.v.fnum);
+	    int e;
+
+	    if (f == FLOAT_FN(floor)(f)
+		&& (FlNum) NUM_MIN < f && f < -(FlNum) NUM_MIN)
+		return hash_num((Num) f);
+	    return hash_num((Num) (FLOAT_FN(frexp)(f, &e) * (1 << 30))) ^ e;
+	}
+    case TYPE_LIST:
+	{
+	    unsigned h = v.v.list[0].v.num;
+	    int i;
+
+	    for (i = 1; i <= v.v.list[0].v.num; i++)
+		h = h * 31 + index_hash(v.v.list[i]);
+	    return h;
+	}
+#ifdef WAIF_CORE
+    case TYPE_WAIF:
+	return hash_num((uintptr_t) v.v.waif);
+#endif
+    default:
+	return 0;
+    }
+}
+
+static void
+build_list_index(List_Index *x)
+{
+    int n = x->list[0].v.num, i;
+    unsigned size = 2 * LIST_INDEX_MIN_LENGTH;
+
+    while (size < 2 * (unsigned) n)
+	size *= 2;
+    x->mask = size - 1;
+    x->buckets = mymalloc(size * sizeof(int), M_LIST_INDEX);
+    memset(x->buckets, 0, size * sizeof(int));
+    x->chain = mymalloc((n + 1) * sizeof(int), M_LIST_INDEX);
+
+    /* Insert back to front, so that each chain is in increasing order. */
+    for (i = n; i >= 1; i--) {
+	int *bucket = &x->buckets[index_hash(x->list[i]) & x->mask];
+
+	x->chain[i] = *bucket;
+	*bucket = i;
+    }
+}
+
+static void
+free_list_index(List_Index *x)
+{
+    if (x->buckets) {
+	myfree(x->buckets, M_LIST_INDEX);
+	myfree(x->chain, M_LIST_INDEX);
+	x->buckets = 0;
+    }
+    x->list = 0;
+    list_indexes_in_use--;
+}
+
+void
+forget_list_index(const Var *list)
+{
+    List_Index *x = list_index_slot(list);
+
+    if (x->list == list)
+	free_list_index(x);
+}
+
 int
 ismember(Var lhs, Var rhs, int case_matters)
 {
     int i;
 
+    if (rhs.v.list[0].v.num >= LIST_INDEX_MIN_LENGTH) {
+	List_Index *x = list_index_slot(rhs.v.list);
+
+	if (x->list == rhs.v.list) {
+	    if (!x->buckets)
+		build_list_index(x);
+	    for (i = x->buckets[index_hash(lhs) & x->mask]; i; i = x->chain[i])
+		if (equality(lhs, rhs.v.list[i], case_matters))
+		    return i;
+	    return 0;
+	}
+	/* First search of this list; just remember it. */
+	if (x->list)
+	    free_list_index(x);
+	x->list = rhs.v.list;
+	list_indexes_in_use++;
+    }
+
     for (i = 1; i <= rhs.v.list[0].v.num; i++) {
 	if (equality(lhs, rhs.v.list[i], case_matters)) {
 	    return i;
@@ -106,6 +250,8 @@ ismember(Var lhs, Var rhs, int case_matters)
 Var
 listset(Var list, Var value, int pos)
 {
+    if (list_indexes_in_use)
+	forget_list_index(list.v.list);
     free_var(list.v.list[pos]);
     list.v.list[pos] = value;
     return list;
@@ -119,6 +265,8 @@ doinsert(Var list, Var value, int pos)
     int size = list.v.list[0].v.num + 1;
 
     if (var_refcount(list) == 1 && pos == size) {
+	if (list_indexes_in_use)
+	    forget_list_index(list.v.list);
 	list.v.list = (Var *) myrealloc(list.v.list, (size + 1) * sizeof(Var), M_LIST);
 	list.v.list[0].v.num = size;
 	list.v.list[pos] = value;
@@ -539,6 +687,393 @@ bf_is_member(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UN
     return make_int_pack(r);
 }
 
+/*
+ * Native sorting and set operations.  Values are ordered the way the
+ * `<' operator orders them, so a list can only be sorted if its elements
+ * are all numbers, all objects, all errors or all strings.  Membership
+ * uses equality(), case-insensitively unless asked otherwise, just as
+ * setadd() and setremove() do.
+ */
+
+enum order_kind { ORD_NONE, ORD_INT, ORD_NUM, ORD_OBJ, ORD_ERR, ORD_STR };
+
+static enum order_kind
+order_kind(const Var *v, int n)
+{
+    enum order_kind kind = ORD_INT;
+    int i, iint = 0, ifloat = 0;
+
+    if (n == 0)
+	return kind;
+    switch (v[1].type) {
+    case TYPE_INT:
+    case TYPE_FLOAT:
+	for (i = 1; i <= n; i++)
+	    if (v[i].type == TYPE_INT)
+		iint = i;
+	    else if (v[i].type == TYPE_FLOAT)
+		ifloat = i;
+	    else
+		return ORD_NONE;
+	if (!ifloat)
+	    return ORD_INT;
+	/* Mixed comparisons are only allowed with the FLOATINT_INEQ pragma. */
+	if (iint && numeric_lt_or_eq(0, v[iint], v[ifloat]).type == TYPE_ERR)
+	    return ORD_NONE;
+	return ORD_NUM;
+    case TYPE_OBJ:
+	kind = ORD_OBJ;
+	break;
+    case TYPE_ERR:
+	kind = ORD_ERR;
+	break;
+    case TYPE_STR:
+	kind = ORD_STR;
+	break;
+    default:
+	return ORD_NONE;
+    }
+    for (i = 2; i <= n; i++)
+	if (v[i].type != v[1].type)
+	    return ORD_NONE;
+    return kind;
+}
+
+/* Comparisons made so far by sort(), unique() or a set_*() function,
+ * which charge a tick for every LIST_WORK_PER_TICK of them.
+ */
+#define LIST_WORK_PER_TICK	256
+
+static Num list_work = 0;
+
+static void
+charge_list_work(void)
+{
+    Num ticks = list_work / LIST_WORK_PER_TICK;
+
+    charge_ticks(ticks > INT32_MAX ? INT32_MAX : (int) ticks);
+    list_work = 0;
+}
+
+static int
+compare_ordered(enum order_kind kind, Var a, Var b, int case_matters)
+{
+    list_work++;
+    switch (kind) {
+    case ORD_INT:
+	return (a.v.num > b.v.num) - (a.v.num < b.v.num);
+    case ORD_NUM:
+	if (!numeric_lt_or_eq(0, a, b).v.num)
+	    return 1;
+	return numeric_lt_or_eq(0, b, a).v.num ? 0 : -1;
+    case ORD_OBJ:
+	return (a.v.obj > b.v.obj) - (a.v.obj < b.v.obj);
+    case ORD_ERR:
+	return (a.v.err > b.v.err) - (a.v.err < b.v.err);
+    case ORD_STR:
+	return (case_matters
+		? strcmp(a.v.str, b.v.str)
+		: mystrcasecmp(a.v.str, b.v.str));
+    default:
+	panic("COMPARE_ORDERED: Unorderable values");
+    }
+    return 0;
+}
+
+/* Stably sorts the 1-based indices ORDER[0..N-1] of KEYS, using TMP as
+ * scratch space.  DIR is 1 for ascending order and -1 for descending.
+ */
+static void
+merge_sort(int *order, int *tmp, int n, const Var *keys,
+	   enum order_kind kind, int case_matters, int dir)
+{
+    int half = n / 2, i, j, k;
+
+    if (n < 2)
+	return;
+    merge_sort(order, tmp, half, keys, kind, case_matters, dir);
+    merge_sort(order + half, tmp, n - half, keys, kind, case_matters, dir);
+    if (dir * compare_ordered(kind, keys[order[half - 1]], keys[order[half]],
+			      case_matters) <= 0)
+	return;			/* already in order */
+
+    memcpy(tmp, order, half * sizeof(int));
+    for (i = 0, j = half, k = 0; i < half && j < n; k++)
+	if (dir * compare_ordered(kind, keys[order[j]], keys[tmp[i]],
+				  case_matters) < 0)
+	    order[k] = order[j++];
+	else
+	    order[k] = tmp[i++];
+    while (i < half)
+	order[k++] = tmp[i++];
+}
+
+static int *
+sorted_order(Var list, enum order_kind kind, int case_matters, int dir)
+{
+    int n = list.v.list[0].v.num, i;
+    int *order = mymalloc((n + 1) * sizeof(int), M_LIST_INDEX);
+    int *tmp = mymalloc((n / 2 + 1) * sizeof(int), M_LIST_INDEX);
+
+    for (i = 0; i < n; i++)
+	order[i] = i + 1;
+    merge_sort(order, tmp, n, list.v.list, kind, case_matters, dir);
+    myfree(tmp, M_LIST_INDEX);
+    return order;
+}
+
+/* Below this length, a list is simply searched linearly. */
+#define LOOKUP_MIN_LENGTH	16
+
+typedef struct {
+    Var list;
+    enum order_kind kind;	/* ORD_NONE if searched linearly */
+    int *order;
+    int case_matters;
+} List_Lookup;
+
+static void
+lookup_init(List_Lookup *l, Var list, int case_matters)
+{
+    l->list = list;
+    l->case_matters = case_matters;
+    l->kind = (list.v.list[0].v.num < LOOKUP_MIN_LENGTH
+	       ? ORD_NONE
+	       : order_kind(list.v.list, list.v.list[0].v.num));
+    if (l->kind == ORD_NUM)	/* ordering and equality disagree */
+	l->kind = ORD_NONE;
+    l->order = (l->kind == ORD_NONE
+		? 0
+		: sorted_order(list, l->kind, case_matters, 1));
+}
+
+/* Returns the index of the first element of the list equal to V, or 0. */
+static int
+lookup_find(List_Lookup *l, Var v)
+{
+    static const var_type kind_type[] = {
+	TYPE_NONE, TYPE_INT, TYPE_NONE, TYPE_OBJ, TYPE_ERR, TYPE_STR
+    };
+    int lo = 0, hi = l->list.v.list[0].v.num;
+
+    if (l->kind == ORD_NONE || v.type == TYPE_FLOAT) {
+	list_work += l->list.v.list[0].v.num;
+	return ismember(v, l->list, l->case_matters);
+    }
+    if (v.type != kind_type[l->kind])
+	return 0;
+    while (lo < hi) {
+	int mid = (lo + hi) / 2;
+
+	if (compare_ordered(l->kind, l->list.v.list[l->order[mid]], v,
+			    l->case_matters) < 0)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    if (lo < l->list.v.list[0].v.num
+	&& !compare_ordered(l->kind, l->list.v.list[l->order[lo]], v,
+			    l->case_matters))
+	return l->order[lo];
+    return 0;
+}
+
+static void
+lookup_free(List_Lookup *l)
+{
+    if (l->order)
+	myfree(l->order, M_LIST_INDEX);
+}
+
+/* Sets KEEP[i] (1-based) iff LIST[i] is the first element equal to it. */
+static void
+mark_first_occurrences(Var list, int case_matters, char *keep)
+{
+    List_Lookup l;
+    int i;
+
+    lookup_init(&l, list, case_matters);
+    for (i = 1; i <= list.v.list[0].v.num; i++)
+	keep[i] = lookup_find(&l, list.v.list[i]) == i;
+    lookup_free(&l);
+}
+
+static Var
+list_of_marked(Var list, const char *keep, int count)
+{
+    Var r = new_list(count);
+    int i, j = 0;
+
+    for (i = 1; i <= list.v.list[0].v.num; i++)
+	if (keep[i])
+	    r.v.list[++j] = var_ref(list.v.list[i]);
+    return r;
+}
+
+static package
+bf_sort(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSED_)
+{				/* (list [, keys [, reverse]]) */
+    Var list = arglist.v.list[1];
+    Var keys = (arglist.v.list[0].v.num >= 2
+		&& arglist.v.list[2].v.list[0].v.num > 0
+		? arglist.v.list[2]
+		: list);		/* {} means "sort by the elements" */
+    int dir = (arglist.v.list[0].v.num >= 3
+	       && is_true(arglist.v.list[3])) ? -1 : 1;
+    int n = list.v.list[0].v.num, i;
+    enum order_kind kind;
+    int *order;
+    Var r;
+
+    if (keys.v.list[0].v.num != n) {
+	free_var(arglist);
+	return make_error_pack(E_INVARG);
+    }
+    if ((kind = order_kind(keys.v.list, n)) == ORD_NONE) {
+	free_var(arglist);
+	return make_error_pack(E_TYPE);
+    }
+
+    order = sorted_order(keys, kind, 0, dir);
+    r = new_list(n);
+    for (i = 0; i < n; i++)
+	r.v.list[i + 1] = var_ref(list.v.list[order[i]]);
+    myfree(order, M_LIST_INDEX);
+    free_var(arglist);
+    charge_list_work();
+    return make_var_pack(r);
+}
+
+static package
+bf_reverse(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSED_)
+{
+    Var list = arglist.v.list[1];
+    int n = list.v.list[0].v.num, i;
+    Var r = new_list(n);
+
+    for (i = 1; i <= n; i++)
+	r.v.list[i] = var_ref(list.v.list[n + 1 - i]);
+    free_var(arglist);
+    return make_var_pack(r);
+}
+
+static package
+bf_unique(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSED_)
+{				/* (list [, case-matters]) */
+    Var list = arglist.v.list[1];
+    int case_matters = (arglist.v.list[0].v.num >= 2
+			&& is_true(arglist.v.list[2]));
+    int n = list.v.list[0].v.num, i, count = 0;
+    char *keep = mymalloc(n + 1, M_LIST_INDEX);
+    Var r;
+
+    mark_first_occurrences(list, case_matters, keep);
+    for (i = 1; i <= n; i++)
+	count += keep[i];
+    r = list_of_marked(list, keep, count);
+    myfree(keep, M_LIST_INDEX);
+    free_var(arglist);
+    charge_list_work();
+    return make_var_pack(r);
+}
+
+static package
+bf_slice(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSED_)
+{				/* (list [, index]) */
+    Var list = arglist.v.list[1];
+    Num index = (arglist.v.list[0].v.num >= 2
+		 ? arglist.v.list[2].v.num
+		 : 1);
+    int n = list.v.list[0].v.num, i;
+    Var r;
+
+    for (i = 1; i <= n; i++) {
+	Var e = list.v.list[i];
+
+	if (e.type != TYPE_LIST) {
+	    free_var(arglist);
+	    return make_error_pack(E_TYPE);
+	}
+	if (index < 1 || index > e.v.list[0].v.num) {
+	    free_var(arglist);
+	    return make_error_pack(E_RANGE);
+	}
+    }
+
+    r = new_list(n);
+    for (i = 1; i <= n; i++)
+	r.v.list[i] = var_ref(list.v.list[i].v.list[index]);
+    free_var(arglist);
+    return make_var_pack(r);
+}
+
+enum set_op { SET_UNION, SET_INTERSECTION, SET_DIFFERENCE };
+
+/* union:  A followed by those elements of B not already present;
+ * intersection:  those elements of A that are in B;
+ * difference:  those elements of A that are not in B.
+ */
+static package
+do_set_op(Var arglist, enum set_op op)
+{
+    Var a = arglist.v.list[1], b = arglist.v.list[2], r;
+    Var from = op == SET_UNION ? b : a;
+    Var in = op == SET_UNION ? a : b;
+    int n = from.v.list[0].v.num, i, count = 0;
+    char *keep = mymalloc(n + 1, M_LIST_INDEX);
+    List_Lookup l;
+
+    if (op == SET_UNION)
+	mark_first_occurrences(b, 0, keep);
+    else
+	memset(keep, 1, n + 1);
+
+    lookup_init(&l, in, 0);
+    for (i = 1; i <= n; i++)
+	if (keep[i]) {
+	    keep[i] = !lookup_find(&l, from.v.list[i]) == (op != SET_INTERSECTION);
+	    count += keep[i];
+	}
+    lookup_free(&l);
+    charge_list_work();
+
+    if (op == SET_UNION) {
+	if (a.v.list[0].v.num + count
+	    > server_int_option_cached(SVO_MAX_LIST_CONCAT)) {
+	    myfree(keep, M_LIST_INDEX);
+	    free_var(arglist);
+	    return make_space_pack();
+	}
+	r = var_ref(a);
+	for (i = 1; i <= n; i++)
+	    if (keep[i])
+		r = listappend(r, var_ref(b.v.list[i]));
+    } else
+	r = list_of_marked(a, keep, count);
+
+    myfree(keep, M_LIST_INDEX);
+    free_var(arglist);
+    return make_var_pack(r);
+}
+
+static package
+bf_set_union(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSED_)
+{
+    return do_set_op(arglist, SET_UNION);
+}
+
+static package
+bf_set_intersection(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSED_)
+{
+    return do_set_op(arglist, SET_INTERSECTION);
+}
+
+static package
+bf_set_difference(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSED_)
+{
+    return do_set_op(arglist, SET_DIFFERENCE);
+}
+
 static package
 bf_strsub(volatile Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSED_)
 {				/* (source, what, with [, case-matters]) */
@@ -650,115 +1185,356 @@ bf_rindex(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSE
     return make_var_pack(r);
 }
 
-static package
-bf_tostr(volatile Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSED_)
+/*
+ * tostr() and toliteral() build their result a chunk at a time, charging
+ * a tick per chunk and yielding between chunks when the task runs short
+ * of ticks or seconds, so that a huge value neither stalls the server nor
+ * aborts the task.  Only the output is accumulated; list nesting is kept
+ * on an explicit stack so that the walk can be resumed.
+ */
+
+#define SERIALIZE_CHUNK		4096	/* bytes of output per tick */
+
+struct unparse_frame {
+    const Var *list;
+    int next;			/* index of the next element to unparse */
+};
+
+struct serialize_data {
+    Var value;			/* toliteral(): the value;
+				 * tostr(): the argument list */
+    int tostr;
+    int next_arg;		/* tostr(): next argument to convert */
+    int started;		/* toliteral(): VALUE itself begun */
+    struct unparse_frame *stack;
+    int depth, max_depth;
+    Stream *s;
+};
+
+static struct serialize_data *
+new_serialize_data(Var value, int tostr)
 {
-    package p;
-    Stream *volatile s = new_stream(100);
+    struct serialize_data *d = alloc_data(sizeof(*d));
+
+    d->value = value;
+    d->tostr = tostr;
+    d->next_arg = 1;
+    d->started = 0;
+    d->depth = 0;
+    d->max_depth = 8;
+    d->stack = mymalloc(d->max_depth * sizeof(*d->stack), M_BI_FUNC_DATA);
+    d->s = new_stream(100);
+    return d;
+}
 
-    TRY_STREAM {
-	int i;
+static void
+free_serialize_data(struct serialize_data *d)
+{
+    free_var(d->value);
+    myfree(d->stack, M_BI_FUNC_DATA);
+    free_stream(d->s);
+    free_data(d);
+}
+
+static void
+literal_begin(struct serialize_data *d, Var v)
+{
+    if (v.type != TYPE_LIST) {
+	unparse_value(d->s, v);
+	return;
+    }
+    if (d->depth == d->max_depth) {
+	d->max_depth *= 2;
+	d->stack = myrealloc(d->stack, d->max_depth * sizeof(*d->stack),
+			     M_BI_FUNC_DATA);
+    }
+    stream_add_char(d->s, '{');
+    d->stack[d->depth].list = v.v.list;
+    d->stack[d->depth].next = 1;
+    d->depth++;
+}
 
-	for (i = 1; i <= arglist.v.list[0].v.num; i++) {
-	    stream_add_tostr(s, arglist.v.list[i]);
+/* Adds at least LIMIT more bytes of output to D->s, unless it finishes
+ * first.  Returns true iff it has finished.
+ */
+static int
+serialize_some(struct serialize_data *d, size_t limit)
+{
+    Stream *s = d->s;
+    size_t stop = stream_length(s) + limit;
+
+    if (d->tostr) {
+	while (d->next_arg <= d->value.v.list[0].v.num) {
+	    if (stream_length(s) >= stop)
+		return 0;
+	    stream_add_tostr(s, d->value.v.list[d->next_arg++]);
 	}
-	p = make_string_pack(str_dup(stream_contents(s)));
+	return 1;
     }
-    EXCEPT (stream_too_big) {
-	p = make_space_pack();
+
+    if (!d->started) {
+	d->started = 1;
+	literal_begin(d, d->value);
     }
-    ENDTRY_STREAM;
-    free_stream(s);
-    free_var(arglist);
-    return p;
+    while (d->depth > 0) {
+	struct unparse_frame *f = &d->stack[d->depth - 1];
+
+	if (stream_length(s) >= stop)
+	    return 0;
+	if (f->next > f->list[0].v.num) {
+	    stream_add_char(s, '}');
+	    d->depth--;
+	} else {
+	    if (f->next > 1)
+		stream_add_string(s, ", ");
+	    literal_begin(d, f->list[f->next++]);
+	}
+    }
+    return 1;
 }
 
 static package
-bf_toliteral(volatile Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSED_)
+serialize(Var arglist, Byte next, void *vdata, int tostr)
 {
+    struct serialize_data *volatile d = vdata;
     package p;
-    Stream *volatile s = new_stream(100);
+
+    if (next == 1) {
+	if (tostr)
+	    d = new_serialize_data(arglist, 1);
+	else {
+	    d = new_serialize_data(var_ref(arglist.v.list[1]), 0);
+	    free_var(arglist);
+	}
+    } else {			/* next == 2, returning from a yield */
+	int resumed = is_true(arglist);
+
+	free_var(arglist);
+	if (!resumed) {
+	    free_serialize_data(d);
+	    return no_var_pack();
+	}
+    }
 
     TRY_STREAM {
-	unparse_value(s, arglist.v.list[1]);
-	p = make_string_pack(str_dup(stream_contents(s)));
+	int done;
+
+	/* Always make some progress, however little time is left. */
+	do
+	    done = serialize_some(d, SERIALIZE_CHUNK);
+	while (!done && charge_ticks(1));
+
+	if (!done && setup_activ_for_yield())
+	    p = make_call_pack(2, d);
+	else {
+	    /* If there's no room on the stack to yield, finish now. */
+	    while (!done)
+		done = serialize_some(d, SERIALIZE_CHUNK);
+	    p = make_string_pack(str_dup(stream_contents(d->s)));
+	}
     }
     EXCEPT (stream_too_big) {
 	p = make_space_pack();
     }
     ENDTRY_STREAM;
-    free_stream(s);
-    free_var(arglist);
+    if (p.kind != BI_CALL)
+	free_serialize_data(d);
     return p;
 }
 
+static package
+bf_tostr(Var arglist, Byte next, void *vdata, Objid progr UNUSED_)
+{
+    return serialize(arglist, next, vdata, 1);
+}
+
+static package
+bf_toliteral(Var arglist, Byte next, void *vdata, Objid progr UNUSED_)
+{
+    return serialize(arglist, next, vdata, 0);
+}
+
+/* For a task killed while the function is waiting to be called back. */
+static void
+bf_serialize_free(void *vdata)
+{
+    free_serialize_data(vdata);
+}
+
+/* Only the value is saved; the output is rebuilt after a restart. */
+static void
+bf_serialize_write(void *vdata)
+{
+    struct serialize_data *d = vdata;
+
+    dbio_printf("bf_serialize data: tostr = %d\n", d->tostr);
+    dbio_write_var(d->value);
+}
+
+static void *
+bf_serialize_read(void)
+{
+    int tostr;
+    Var value;
+
+    if (dbio_scxnf("bf_serialize data: tostr = %d", &tostr)
+	&& dbio_read_var(&value))
+	return new_serialize_data(value, tostr);
+    return 0;
+}
+
+/* Compiled patterns are cached, most recently used first, and found by
+ * a hash on the pattern text.  The number kept is
+ * $server_options.pattern_cache_size (default PATTERN_CACHE_SIZE).
+ */
 struct pat_cache_entry {
     char *string;
+    unsigned hash;
     int case_matters;
     Pattern pattern;
-    struct pat_cache_entry *next;
+    struct pat_cache_entry *chain;		/* next in hash bucket */
+    struct pat_cache_entry *prev, *next;	/* LRU order */
 };
 
-static struct pat_cache_entry *pat_cache;
-static struct pat_cache_entry pat_cache_entries[PATTERN_CACHE_SIZE];
+static struct pat_cache_entry **pat_table;
+static unsigned pat_table_size;
+static unsigned pat_count;
+static struct pat_cache_entry *pat_lru_first, *pat_lru_last;
+static unsigned pat_cache_hits, pat_cache_misses;
 
 static void
 setup_pattern_cache(void)
 {
-    int i;
+    pat_table_size = 64;
+    pat_table = mymalloc(pat_table_size * sizeof(*pat_table), M_PATTERN);
+    memset(pat_table, 0, pat_table_size * sizeof(*pat_table));
+    pat_count = 0;
+    pat_lru_first = pat_lru_last = 0;
+}
 
-    for (i = 0; i < PATTERN_CACHE_SIZE; i++) {
-	pat_cache_entries[i].string = 0;
-	pat_cache_entries[i].pattern.ptr = 0;
-    }
+static unsigned
+pattern_hash(const char *string, int case_matters)
+{
+    unsigned h = 5381;
+
+    while (*string)
+	h = h * 33 + (unsigned char) *string++;
+    return h ^ (case_matters ? 0x9e3779b9 : 0);
+}
 
-    for (i = 0; i < PATTERN_CACHE_SIZE - 1; i++)
-	pat_cache_entries[i].next = &(pat_cache_entries[i + 1]);
-    pat_cache_entries[PATTERN_CACHE_SIZE - 1].next = 0;
+static void
+pat_lru_unlink(struct pat_cache_entry *e)
+{
+    if (e->prev)
+	e->prev->next = e->next;
+    else
+	pat_lru_first = e->next;
+    if (e->next)
+	e->next->prev = e->prev;
+    else
+	pat_lru_last = e->prev;
+}
 
-    pat_cache = &(pat_cache_entries[0]);
+static void
+pat_lru_push(struct pat_cache_entry *e)
+{
+    e->prev = 0;
+    e->next = pat_lru_first;
+    if (pat_lru_first)
+	pat_lru_first->prev = e;
+    else
+	pat_lru_last = e;
+    pat_lru_first = e;
+}
+
+static void
+pat_table_grow(void)
+{
+    unsigned new_size = 2 * pat_table_size, i;
+    struct pat_cache_entry **new_table, *e, *chain;
+
+    new_table = mymalloc(new_size * sizeof(*new_table), M_PATTERN);
+    memset(new_table, 0, new_size * sizeof(*new_table));
+    for (i = 0; i < pat_table_size; i++)
+	for (e = pat_table[i]; e; e = chain) {
+	    chain = e->chain;
+	    e->chain = new_table[e->hash & (new_size - 1)];
+	    new_table[e->hash & (new_size - 1)] = e;
+	}
+    myfree(pat_table, M_PATTERN);
+    pat_table = new_table;
+    pat_table_size = new_size;
+}
+
+static void
+pat_evict(struct pat_cache_entry *e)
+{
+    struct pat_cache_entry **pp = &pat_table[e->hash & (pat_table_size - 1)];
+
+    while (*pp != e)
+	pp = &(*pp)->chain;
+    *pp = e->chain;
+    pat_lru_unlink(e);
+    free_str(e->string);
+    free_pattern(e->pattern);
+    myfree(e, M_PATTERN);
+    pat_count--;
 }
 
 static Pattern
 get_pattern(const char *string, int case_matters)
 {
-    struct pat_cache_entry *entry, **entry_ptr;
-
-    entry = pat_cache;
-    entry_ptr = &pat_cache;
+    unsigned hash = pattern_hash(string, case_matters);
+    unsigned capacity = server_int_option_cached(SVO_PATTERN_CACHE_SIZE);
+    struct pat_cache_entry *e;
+    Pattern pattern;
 
-    while (1) {
-	if (entry->string && !strcmp(string, entry->string)
-	    && case_matters == entry->case_matters) {
+    for (e = pat_table[hash & (pat_table_size - 1)]; e; e = e->chain)
+	if (e->hash == hash && e->case_matters == case_matters
+	    && !strcmp(string, e->string)) {
 	    /* A cache hit; move this entry to the front of the cache. */
-	    break;
-	} else if (!entry->next) {
-	    /* A cache miss; this is the last entry in the cache, so reuse that
-	     * one for this pattern, moving it to the front of the cache iff
-	     * the compilation succeeds.
-	     */
-	    if (entry->string) {
-		free_str(entry->string);
-		free_pattern(entry->pattern);
-	    }
-	    entry->pattern = new_pattern(string, case_matters);
-	    entry->case_matters = case_matters;
-	    if (!entry->pattern.ptr)
-		entry->string = 0;
-	    else
-		entry->string = str_dup(string);
-	    break;
-	} else {
-	    /* not done searching the cache... */
-	    entry_ptr = &(entry->next);
-	    entry = entry->next;
+	    pat_cache_hits++;
+	    pat_lru_unlink(e);
+	    pat_lru_push(e);
+	    return e->pattern;
 	}
-    }
 
-    *entry_ptr = entry->next;
-    entry->next = pat_cache;
-    pat_cache = entry;
-    return entry->pattern;
+    /* A cache miss; only successfully compiled patterns are kept. */
+    pat_cache_misses++;
+    pattern = new_pattern(string, case_matters);
+    if (!pattern.ptr)
+	return pattern;
+
+    while (pat_count >= capacity && pat_lru_last)
+	pat_evict(pat_lru_last);
+    if (pat_count >= pat_table_size)
+	pat_table_grow();
+
+    e = mymalloc(sizeof(*e), M_PATTERN);
+    e->string = str_dup(string);
+    e->hash = hash;
+    e->case_matters = case_matters;
+    e->pattern = pattern;
+    e->chain = pat_table[hash & (pat_table_size - 1)];
+    pat_table[hash & (pat_table_size - 1)] = e;
+    pat_lru_push(e);
+    pat_count++;
+    return pattern;
+}
+
+static package
+bf_pattern_cache_stats(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSED_)
+{
+    Var r = new_list(4);
+
+    free_var(arglist);
+    r.v.list[1].type = r.v.list[2].type = TYPE_INT;
+    r.v.list[3].type = r.v.list[4].type = TYPE_INT;
+    r.v.list[1].v.num = pat_cache_hits;
+    r.v.list[2].v.num = pat_cache_misses;
+    r.v.list[3].v.num = pat_count;
+    r.v.list[4].v.num = server_int_option_cached(SVO_PATTERN_CACHE_SIZE);
+    return make_var_pack(r);
 }
 
 static Var
@@ -951,64 +1727,214 @@ bf_value_bytes(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr
     return make_var_pack(r);
 }
 
+/* Digests for string_hash(), binary_hash() and value_hash().  MD5 is the
+ * default, for compatibility; FNV64 is a fast non-cryptographic 64-bit
+ * hash (FNV-1a) for when that is all that's wanted.
+ */
+enum hash_algorithm { HASH_MD5, HASH_SHA256, HASH_FNV64 };
+
+typedef struct {
+    enum hash_algorithm algorithm;
+    union {
+	md5ctx_t md5;
+	sha256ctx_t sha256;
+	uint64_t fnv64;
+    } u;
+} hash_state;
+
+static int
+parse_hash_algorithm(Var arglist, int argno, enum hash_algorithm *algorithm)
+{
+    const char *name;
+
+    *algorithm = HASH_MD5;
+    if (arglist.v.list[0].v.num < argno)
+	return 1;
+    name = arglist.v.list[argno].v.str;
+    if (!mystrcasecmp(name, "md5"))
+	*algorithm = HASH_MD5;
+    else if (!mystrcasecmp(name, "sha256"))
+	*algorithm = HASH_SHA256;
+    else if (!mystrcasecmp(name, "fnv64"))
+	*algorithm = HASH_FNV64;
+    else
+	return 0;
+    return 1;
+}
+
+static void
+hash_init(hash_state *h, enum hash_algorithm algorithm)
+{
+    h->algorithm = algorithm;
+    switch (algorithm) {
+    case HASH_MD5:
+	md5_Init(&h->u.md5);
+	break;
+    case HASH_SHA256:
+	sha256_Init(&h->u.sha256);
+	break;
+    case HASH_FNV64:
+	h->u.fnv64 = UINT64_C(0xcbf29ce484222325);
+	break;
+    }
+}
+
+static void
+hash_update(hash_state *h, const char *input, size_t length)
+{
+    switch (h->algorithm) {
+    case HASH_MD5:
+	md5_Update(&h->u.md5, (uint8_t *) input, length);
+	break;
+    case HASH_SHA256:
+	sha256_Update(&h->u.sha256, (const uint8_t *) input, length);
+	break;
+    case HASH_FNV64:
+	{
+	    uint64_t x = h->u.fnv64;
+	    const unsigned char *p = (const unsigned char *) input;
+
+	    while (length--) {
+		x ^= *p++;
+		x *= UINT64_C(0x100000001b3);
+	    }
+	    h->u.fnv64 = x;
+	}
+	break;
+    }
+}
+
+/* Returns the digest as a new string of upper-case hex digits. */
 static const char *
-hash_bytes(const char *input, size_t length)
+hash_final(hash_state *h)
 {
-    md5ctx_t context;
-    uint8_t result[16];
-    int i;
     const char digits[] = "0123456789ABCDEF";
-    char *hex = str_dup("12345678901234567890123456789012");
-    const char *answer = hex;
-
-    md5_Init(&context);
-    md5_Update(&context, (uint8_t *) input, length);
-    md5_Final(&context, result);
-    for (i = 0; i < 16; i++) {
-	*hex++ = digits[result[i] >> 4];
-	*hex++ = digits[result[i] & 0xF];
+    uint8_t result[32];
+    char hex[2 * sizeof(result) + 1];
+    int i, n = 0;
+
+    switch (h->algorithm) {
+    case HASH_MD5:
+	md5_Final(&h->u.md5, result);
+	n = 16;
+	break;
+    case HASH_SHA256:
+	sha256_Final(&h->u.sha256, result);
+	n = 32;
+	break;
+    case HASH_FNV64:
+	for (n = 0; n < 8; n++)
+	    result[n] = (uint8_t) (h->u.fnv64 >> (56 - 8 * n));
+	break;
+    }
+    for (i = 0; i < n; i++) {
+	hex[2 * i] = digits[result[i] >> 4];
+	hex[2 * i + 1] = digits[result[i] & 0xF];
+    }
+    hex[2 * n] = '\0';
+    return str_dup(hex);
+}
+
+static const char *
+hash_bytes(const char *input, size_t length, enum hash_algorithm algorithm)
+{
+    hash_state h;
+
+    hash_init(&h, algorithm);
+    hash_update(&h, input, length);
+    return hash_final(&h);
+}
+
+/* Feeds H exactly the bytes that unparse_value() would produce for V,
+ * without ever holding more than one scalar's worth of them.
+ */
+static void
+hash_value(hash_state *h, Var v, Stream *scratch)
+{
+    switch (v.type) {
+    case TYPE_STR:
+	{
+	    const char *str = v.v.str, *run = str;
+
+	    hash_update(h, "\"", 1);
+	    for (; *str; str++)
+		if (*str == '"' || *str == '\\') {
+		    hash_update(h, run, str - run);
+		    hash_update(h, "\\", 1);
+		    run = str;
+		}
+	    hash_update(h, run, str - run);
+	    hash_update(h, "\"", 1);
+	}
+	break;
+    case TYPE_LIST:
+	{
+	    int len = v.v.list[0].v.num, i;
+
+	    hash_update(h, "{", 1);
+	    for (i = 1; i <= len; i++) {
+		if (i > 1)
+		    hash_update(h, ", ", 2);
+		hash_value(h, v.v.list[i], scratch);
+	    }
+	    hash_update(h, "}", 1);
+	}
+	break;
+    default:
+	unparse_value(scratch, v);
+	hash_update(h, stream_contents(scratch), stream_length(scratch));
+	reset_stream(scratch);
+	break;
     }
-    return answer;
 }
 
 static package
 bf_binary_hash(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSED_)
 {
     size_t length;
+    enum hash_algorithm algorithm;
     const char *bytes = moobinary_to_raw_bytes(arglist.v.list[1].v.str, &length);
+    int ok = parse_hash_algorithm(arglist, 2, &algorithm);
 
     free_var(arglist);
-    if (!bytes)
+    if (!bytes || !ok)
 	return make_error_pack(E_INVARG);
-    return make_string_pack(hash_bytes(bytes, length));
+    return make_string_pack(hash_bytes(bytes, length, algorithm));
 }
 
 static package
 bf_string_hash(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSED_)
 {
     package p;
+    enum hash_algorithm algorithm;
     const char *str = arglist.v.list[1].v.str;
 
-    p = make_string_pack(hash_bytes(str, memo_strlen(str)));
+    if (!parse_hash_algorithm(arglist, 2, &algorithm))
+	p = make_error_pack(E_INVARG);
+    else
+	p = make_string_pack(hash_bytes(str, memo_strlen(str), algorithm));
     free_var(arglist);
     return p;
 }
 
 static package
-bf_value_hash(volatile Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSED_)
+bf_value_hash(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSED_)
 {
+    static Stream *scratch = 0;
     package p;
-    Stream *volatile s = new_stream(100);
+    enum hash_algorithm algorithm;
+    hash_state h;
 
-    TRY_STREAM {
-	unparse_value(s, arglist.v.list[1]);
-	p = make_string_pack(hash_bytes(stream_contents(s), stream_length(s)));
-    }
-    EXCEPT (stream_too_big) {
-	p = make_space_pack();
+    if (!scratch)
+	scratch = new_stream(100);
+
+    if (!parse_hash_algorithm(arglist, 2, &algorithm))
+	p = make_error_pack(E_INVARG);
+    else {
+	hash_init(&h, algorithm);
+	hash_value(&h, arglist.v.list[1], scratch);
+	p = make_string_pack(hash_final(&h));
     }
-    ENDTRY_STREAM;
-    free_stream(s);
     free_var(arglist);
     return p;
 }
@@ -1420,10 +2346,12 @@ bf_decode_chars(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr
 void
 register_list(void)
 {
+    unsigned f;
+
     register_function("value_bytes", 1, 1, bf_value_bytes, TYPE_ANY);
-    register_function("value_hash", 1, 1, bf_value_hash, TYPE_ANY);
-    register_function("string_hash", 1, 1, bf_string_hash, TYPE_STR);
-    register_function("binary_hash", 1, 1, bf_binary_hash, TYPE_STR);
+    register_function("value_hash", 1, 2, bf_value_hash, TYPE_ANY, TYPE_STR);
+    register_function("string_hash", 1, 2, bf_string_hash, TYPE_STR, TYPE_STR);
+    register_function("binary_hash", 1, 2, bf_binary_hash, TYPE_STR, TYPE_STR);
     register_function("decode_binary", 1, 2, bf_decode_binary,
 		      TYPE_STR, TYPE_ANY);
     register_function("encode_binary", 0, -1, bf_encode_binary);
@@ -1440,13 +2368,29 @@ register_list(void)
 		      TYPE_LIST, TYPE_ANY, TYPE_INT);
     register_function("equal", 2, 2, bf_equal, TYPE_ANY, TYPE_ANY);
     register_function("is_member", 2, 2, bf_is_member, TYPE_ANY, TYPE_LIST);
+    register_function("sort", 1, 3, bf_sort, TYPE_LIST, TYPE_LIST, TYPE_ANY);
+    register_function("reverse", 1, 1, bf_reverse, TYPE_LIST);
+    register_function("unique", 1, 2, bf_unique, TYPE_LIST, TYPE_ANY);
+    register_function("slice", 1, 2, bf_slice, TYPE_LIST, TYPE_INT);
+    register_function("set_union", 2, 2, bf_set_union, TYPE_LIST, TYPE_LIST);
+    register_function("set_intersection", 2, 2, bf_set_intersection,
+		      TYPE_LIST, TYPE_LIST);
+    register_function("set_difference", 2, 2, bf_set_difference,
+		      TYPE_LIST, TYPE_LIST);
 
     /* string */
-    register_function("tostr", 0, -1, bf_tostr);
-    register_function("toliteral", 1, 1, bf_toliteral, TYPE_ANY);
+    f = register_function_with_read_write("tostr", 0, -1, bf_tostr,
+					  bf_serialize_read,
+					  bf_serialize_write);
+    register_function_free(f, bf_serialize_free);
+    f = register_function_with_read_write("toliteral", 1, 1, bf_toliteral,
+					  bf_serialize_read,
+					  bf_serialize_write, TYPE_ANY);
+    register_function_free(f, bf_serialize_free);
     setup_pattern_cache();
     register_function("match", 2, 3, bf_match, TYPE_STR, TYPE_STR, TYPE_ANY);
     register_function("rmatch", 2, 3, bf_rmatch, TYPE_STR, TYPE_STR, TYPE_ANY);
+    register_function("pattern_cache_stats", 0, 0, bf_pattern_cache_stats);
     register_function("substitute", 2, 2, bf_substitute, TYPE_STR, TYPE_LIST);
     register_function("crypt", 1, 2, bf_crypt, TYPE_STR, TYPE_STR);
     register_function("index", 2, 3, bf_index, TYPE_STR, TYPE_STR, TYPE_ANY);
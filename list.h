@@ -28,6 +28,14 @@ extern Var listset(Var list, Var value, int pos);
 extern Var listrangeset(Var list, Num from, Num after, Var value);
 extern Var listconcat(Var first, Var second);
 extern int ismember(Var value, Var list, int case_matters);
+
+extern int list_indexes_in_use;
+extern void forget_list_index(const Var *list);
+				/* Must be called (if list_indexes_in_use)
+				 * before a list's storage is modified in place
+				 * or freed, to drop any membership index on it.
+				 */
+
 extern Var setadd(Var list, Var value);
 extern Var setremove(Var list, Var value);
 extern Var sublist(Var list, Num first, Num after);
@@ -566,6 +566,34 @@ bf_set_player_flag(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid pr
     return no_var_pack();
 }
 
+static package
+bf_owned_objects(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSED_)
+{				/* (owner) */
+    Objid owner = arglist.v.list[1].v.obj;
+    struct children_data d;
+
+    free_var(arglist);
+
+    d.r = new_list(db_count_owned(owner));
+    d.i = 0;
+    db_for_all_owned(owner, add_to_list, &d);
+
+    return make_var_pack(d.r);
+}
+
+static package
+bf_owned_bytes(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr)
+{				/* (owner) */
+    Objid owner = arglist.v.list[1].v.obj;
+
+    free_var(arglist);
+
+    if (!is_wizard(progr))
+	return make_error_pack(E_PERM);
+
+    return make_int_pack(db_owned_bytes(owner));
+}
+
 static package
 bf_object_bytes(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr)
 {
@@ -585,9 +613,164 @@ bf_object_bytes(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr
     return make_var_pack(v);
 }
 
+/*** Bulk queries over the whole object table ***/
+
+#define QUERY_CHUNK	256	/* objects examined per tick charged */
+
+struct query_data {
+    int kind;			/* a db_object_query kind */
+    Var arg;			/* the query's argument */
+    Objid next;			/* next object to examine */
+    Var r;			/* matches found so far */
+};
+
+static int
+query_flag(const char *name, db_object_flag *flag)
+{
+    static const struct {
+	const char *name;
+	db_object_flag flag;
+    } flags[] = {
+	{"player", FLAG_USER},
+	{"programmer", FLAG_PROGRAMMER},
+	{"wizard", FLAG_WIZARD},
+	{"r", FLAG_READ},
+	{"w", FLAG_WRITE},
+	{"f", FLAG_FERTILE}
+    };
+    unsigned i;
+
+    for (i = 0; i < Arraysize(flags); i++)
+	if (!mystrcasecmp(name, flags[i].name)) {
+	    *flag = flags[i].flag;
+	    return 1;
+	}
+    return 0;
+}
+
+static void
+free_query_data(struct query_data *d)
+{
+    free_var(d->arg);
+    free_var(d->r);
+    free_data(d);
+}
+
+static package
+do_query(int kind, Var arglist, Byte next, void *vdata, Objid progr)
+{
+    struct query_data *d = vdata;
+    db_object_query q;
+    Var r;
+
+    if (next == 1) {
+	Var arg = arglist.v.list[1];
+
+	if ((kind == DBQ_DESCENDANTS && !valid(arg.v.obj))
+	    || (kind == DBQ_FLAGGED && !query_flag(arg.v.str, &q.flag))) {
+	    free_var(arglist);
+	    return make_error_pack(E_INVARG);
+	}
+	d = alloc_data(sizeof(*d));
+	d->kind = kind;
+	d->arg = var_ref(arg);
+	d->next = (kind == DBQ_DESCENDANTS ? arg.v.obj : 0);
+	d->r = new_list(0);
+	free_var(arglist);
+    } else {			/* next == 2, returning from a yield */
+	int resumed = is_true(arglist);
+
+	free_var(arglist);
+	if (!resumed) {
+	    free_query_data(d);
+	    return no_var_pack();
+	}
+    }
+
+    q.kind = d->kind;
+    q.progr = progr;
+    if (q.kind == DBQ_DESCENDANTS)
+	q.obj = d->arg.v.obj;
+    else if (q.kind == DBQ_FLAGGED)
+	query_flag(d->arg.v.str, &q.flag);
+    else
+	q.name = d->arg.v.str;
+
+    /* Always make some progress, however little time is left. */
+    do
+	d->next = db_query_objects(&q, d->next, QUERY_CHUNK, &d->r);
+    while (d->next != NOTHING && charge_ticks(1));
+
+    if (d->next != NOTHING) {
+	if (setup_activ_for_yield())
+	    return make_call_pack(2, d);
+	/* No room on the stack to yield; finish the query now. */
+	while (d->next != NOTHING)
+	    d->next = db_query_objects(&q, d->next, QUERY_CHUNK, &d->r);
+    }
+    r = d->r;
+    d->r = zero;
+    free_query_data(d);
+    return make_var_pack(r);
+}
+
+static package
+bf_descendants(Var arglist, Byte next, void *vdata, Objid progr)
+{				/* (object) */
+    return do_query(DBQ_DESCENDANTS, arglist, next, vdata, progr);
+}
+
+static package
+bf_flagged_objects(Var arglist, Byte next, void *vdata, Objid progr)
+{				/* (flag-name) */
+    return do_query(DBQ_FLAGGED, arglist, next, vdata, progr);
+}
+
+static package
+bf_defining_objects(Var arglist, Byte next, void *vdata, Objid progr)
+{				/* (property-name) */
+    return do_query(DBQ_DEFINING, arglist, next, vdata, progr);
+}
+
+/* For a task killed while the query is waiting to be called back. */
+static void
+bf_query_free(void *vdata)
+{
+    free_query_data(vdata);
+}
+
+static void
+bf_query_write(void *vdata)
+{
+    struct query_data *d = vdata;
+
+    dbio_printf("bf_query data: kind = %d, next = %"PRIdN"\n",
+		d->kind, d->next);
+    dbio_write_var(d->arg);
+    dbio_write_var(d->r);
+}
+
+static void *
+bf_query_read(void)
+{
+    struct query_data *d = alloc_data(sizeof(*d));
+
+    if (dbio_scxnf("bf_query data: kind = %d, next = %"SCNdN,
+		   &d->kind, &d->next)
+	&& dbio_read_var(&d->arg)) {
+	if (dbio_read_var(&d->r))
+	    return d;
+	free_var(d->arg);
+    }
+    free_data(d);
+    return 0;
+}
+
 void
 register_objects(void)
 {
+    unsigned f;
+
     register_function("toobj", 1, 1, bf_toobj, TYPE_ANY);
     register_function("typeof", 1, 1, bf_typeof, TYPE_ANY);
     register_function_with_read_write("create", 1, 2, bf_create,
@@ -597,6 +780,8 @@ register_objects(void)
 				      bf_recycle_read, bf_recycle_write,
 				      TYPE_OBJ);
     register_function("object_bytes", 1, 1, bf_object_bytes, TYPE_OBJ);
+    register_function("owned_objects", 1, 1, bf_owned_objects, TYPE_OBJ);
+    register_function("owned_bytes", 1, 1, bf_owned_bytes, TYPE_OBJ);
     register_function("valid", 1, 1, bf_valid, TYPE_OBJ);
     register_function("parent", 1, 1, bf_parent, TYPE_OBJ);
     register_function("children", 1, 1, bf_children, TYPE_OBJ);
@@ -609,6 +794,22 @@ register_objects(void)
     register_function_with_read_write("move", 2, 2, bf_move,
 				      bf_move_read, bf_move_write,
 				      TYPE_OBJ, TYPE_OBJ);
+
+    f = register_function_with_read_write("descendants", 1, 1,
+					  bf_descendants,
+					  bf_query_read, bf_query_write,
+					  TYPE_OBJ);
+    register_function_free(f, bf_query_free);
+    f = register_function_with_read_write("flagged_objects", 1, 1,
+					  bf_flagged_objects,
+					  bf_query_read, bf_query_write,
+					  TYPE_STR);
+    register_function_free(f, bf_query_free);
+    f = register_function_with_read_write("defining_objects", 1, 1,
+					  bf_defining_objects,
+					  bf_query_read, bf_query_write,
+					  TYPE_STR);
+    register_function_free(f, bf_query_free);
 }
 
 
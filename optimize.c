@@ -0,0 +1,458 @@
+/******************************************************************************
+  Copyright (c) 1992, 1995, 1996 Xerox Corporation.  All rights reserved.
+  Portions of this code were written by Stephen White, aka ghond.
+  Use and copying of this software and preparation of derivative works based
+  upon this software are permitted.  Any distribution of this software or
+  derivative works must comply with all applicable United States export
+  control laws.  This software is made available AS IS, and Xerox Corporation
+  makes no warranty about the software, its performance or its conformity to
+  any specification.  Any person obtaining a copy of this software is requested
+  to send their name and post office or electronic mail address to:
+    Pavel Curtis
+    Xerox PARC
+    3333 Coyote Hill Rd.
+    Palo Alto, CA 94304
+    Pavel@Xerox.Com
+ *****************************************************************************/
+
+/* Constant folding and dead-code elimination; see optimize.h.
+ *
+ * Everything here works on a tree whose allocation pool has already been
+ * released, so nodes are reused in place and anything dropped goes back
+ * through free_expr()/free_stmt().  Only folds whose result the server
+ * would compute identically at run time, and which unparse to source that
+ * parses back to the same value, are made:
+ *   - arithmetic on integers (floats are left alone, since their printed
+ *     form need not read back exactly), unless it would raise an error or
+ *     produce NUM_MIN, which has no literal;
+ *   - string concatenation and list construction, only up to the smallest
+ *     max_string_concat/max_list_concat a database can set, so folding
+ *     never hides an E_QUOTA;
+ *   - !, &&, || and ?: on a constant condition;
+ *   - if/elseif arms whose condition is constant, unnamed while loops whose
+ *     condition is constantly false, and statements following a return,
+ *     break or continue in the same block.
+ * Folded expressions cost no ticks at run time, and pruned conditions are
+ * not evaluated at all.
+ */
+
+#include "my-string.h"
+
+#include "ast.h"
+#include "list.h"
+#include "numbers.h"
+#include "optimize.h"
+#include "storage.h"
+#include "structures.h"
+#include "utils.h"
+
+/* Replace E by the literal V, freeing E's operands. */
+static void
+become_literal(Expr * e, Var v)
+{
+    Expr *old = mymalloc(sizeof(Expr), M_AST);
+
+    *old = *e;
+    free_expr(old);
+    e->kind = EXPR_VAR;
+    e->e.var = v;
+}
+
+/* Replace E by the operand in *SLOT, freeing the rest of E. */
+static void
+become_operand(Expr * e, Expr ** slot)
+{
+    Expr *keep = *slot;
+    Expr *old = mymalloc(sizeof(Expr), M_AST);
+
+    *slot = mymalloc(sizeof(Expr), M_AST);
+    (*slot)->kind = EXPR_VAR;
+    (*slot)->e.var = zero;
+    *old = *e;
+    free_expr(old);
+    *e = *keep;
+    myfree(keep, M_AST);
+}
+
+static int
+is_literal(Expr * e)
+{
+    return e->kind == EXPR_VAR;
+}
+
+/* A literal the folder may compute with or put into a folded list. */
+static int
+is_exact_literal(Expr * e)
+{
+    if (e->kind != EXPR_VAR)
+	return 0;
+    switch (e->e.var.type) {
+    case TYPE_INT:
+	return e->e.var.v.num != NUM_MIN;
+    case TYPE_STR:
+    case TYPE_OBJ:
+    case TYPE_ERR:
+    case TYPE_LIST:
+	return 1;
+    default:
+	return 0;
+    }
+}
+
+static void
+fold_binary(Expr * e)
+{
+    Var lhs, rhs, ans;
+
+    if (!is_exact_literal(e->e.bin.lhs) || !is_exact_literal(e->e.bin.rhs))
+	return;
+    lhs = e->e.bin.lhs->e.var;
+    rhs = e->e.bin.rhs->e.var;
+
+    if (e->kind == EXPR_PLUS
+	&& lhs.type == TYPE_STR && rhs.type == TYPE_STR) {
+	int llen = strlen(lhs.v.str);
+	int flen = llen + strlen(rhs.v.str);
+	char *str;
+
+	if (flen >= MIN_STRING_CONCAT_LIMIT)
+	    return;
+	str = mymalloc(flen + 1, M_STRING);
+	strcpy(str, lhs.v.str);
+	strcpy(str + llen, rhs.v.str);
+	ans.type = TYPE_STR;
+	ans.v.str = str;
+	become_literal(e, ans);
+	return;
+    }
+
+    if (lhs.type != TYPE_INT || rhs.type != TYPE_INT)
+	return;
+
+    switch (e->kind) {
+    case EXPR_PLUS:
+	ans = do_add(lhs, rhs);
+	break;
+    case EXPR_MINUS:
+	ans = do_subtract(lhs, rhs);
+	break;
+    case EXPR_TIMES:
+	ans = do_multiply(lhs, rhs);
+	break;
+    case EXPR_DIVIDE:
+	ans = do_divide(lhs, rhs);
+	break;
+    case EXPR_MOD:
+	ans = do_modulus(lhs, rhs);
+	break;
+    case EXPR_EXP:
+	ans = do_power(lhs, rhs);
+	break;
+    case EXPR_BITAND:
+	ans.type = TYPE_INT;
+	ans.v.num = lhs.v.num & rhs.v.num;
+	break;
+    case EXPR_BITOR:
+	ans.type = TYPE_INT;
+	ans.v.num = lhs.v.num | rhs.v.num;
+	break;
+    case EXPR_BITXOR:
+	ans.type = TYPE_INT;
+	ans.v.num = lhs.v.num ^ rhs.v.num;
+	break;
+    default:
+	return;
+    }
+
+    if (ans.type == TYPE_INT && ans.v.num != NUM_MIN)
+	become_literal(e, ans);
+}
+
+static void
+fold_list(Expr * e)
+{
+    Arg_List *a;
+    Var list;
+    int n = 0;
+
+    for (a = e->e.list; a; a = a->next)
+	if (a->kind != ARG_NORMAL || !is_exact_literal(a->expr)
+	    || ++n >= MIN_LIST_CONCAT_LIMIT)
+	    return;
+
+    list = new_list(n);
+    for (n = 1, a = e->e.list; a; a = a->next)
+	list.v.list[n++] = var_ref(a->expr->e.var);
+    become_literal(e, list);
+}
+
+static void fold_expr(Expr *);
+
+static void
+fold_arg_list(Arg_List * args)
+{
+    for (; args; args = args->next)
+	fold_expr(args->expr);
+}
+
+static void
+fold_expr(Expr * e)
+{
+    Scatter *sc;
+    Var ans;
+
+    switch (e->kind) {
+    case EXPR_VAR:
+    case EXPR_ID:
+    case EXPR_LENGTH:
+	break;
+
+    case EXPR_PROP:
+    case EXPR_INDEX:
+    case EXPR_ASGN:
+    case EXPR_EQ:
+    case EXPR_NE:
+    case EXPR_LT:
+    case EXPR_LE:
+    case EXPR_GT:
+    case EXPR_GE:
+    case EXPR_IN:
+    case EXPR_SHL:
+    case EXPR_SHR:
+    case EXPR_LSHR:
+	fold_expr(e->e.bin.lhs);
+	fold_expr(e->e.bin.rhs);
+	break;
+
+    case EXPR_PLUS:
+    case EXPR_MINUS:
+    case EXPR_TIMES:
+    case EXPR_DIVIDE:
+    case EXPR_MOD:
+    case EXPR_EXP:
+    case EXPR_BITAND:
+    case EXPR_BITOR:
+    case EXPR_BITXOR:
+	fold_expr(e->e.bin.lhs);
+	fold_expr(e->e.bin.rhs);
+	fold_binary(e);
+	break;
+
+    case EXPR_AND:
+    case EXPR_OR:
+	fold_expr(e->e.bin.lhs);
+	fold_expr(e->e.bin.rhs);
+	if (is_literal(e->e.bin.lhs)) {
+	    int short_circuit = (is_true(e->e.bin.lhs->e.var)
+				 == (e->kind == EXPR_OR));
+
+	    become_operand(e, short_circuit ? &e->e.bin.lhs : &e->e.bin.rhs);
+	}
+	break;
+
+    case EXPR_NEGATE:
+    case EXPR_COMPLEMENT:
+	fold_expr(e->e.expr);
+	if (is_exact_literal(e->e.expr) && e->e.expr->e.var.type == TYPE_INT) {
+	    ans.type = TYPE_INT;
+	    ans.v.num = (e->kind == EXPR_NEGATE
+			 ? -e->e.expr->e.var.v.num
+			 : ~e->e.expr->e.var.v.num);
+	    if (ans.v.num != NUM_MIN)
+		become_literal(e, ans);
+	}
+	break;
+
+    case EXPR_NOT:
+	fold_expr(e->e.expr);
+	if (is_literal(e->e.expr)) {
+	    ans.type = TYPE_INT;
+	    ans.v.num = !is_true(e->e.expr->e.var);
+	    become_literal(e, ans);
+	}
+	break;
+
+    case EXPR_COND:
+	fold_expr(e->e.cond.condition);
+	fold_expr(e->e.cond.consequent);
+	fold_expr(e->e.cond.alternate);
+	if (is_literal(e->e.cond.condition))
+	    become_operand(e, (is_true(e->e.cond.condition->e.var)
+			       ? &e->e.cond.consequent
+			       : &e->e.cond.alternate));
+	break;
+
+    case EXPR_LIST:
+	fold_arg_list(e->e.list);
+	fold_list(e);
+	break;
+
+    case EXPR_VERB:
+	fold_expr(e->e.verb.obj);
+	fold_expr(e->e.verb.verb);
+	fold_arg_list(e->e.verb.args);
+	break;
+
+    case EXPR_RANGE:
+	fold_expr(e->e.range.base);
+	fold_expr(e->e.range.from);
+	fold_expr(e->e.range.to);
+	break;
+
+    case EXPR_CALL:
+	fold_arg_list(e->e.call.args);
+	break;
+
+    case EXPR_CATCH:
+	fold_expr(e->e.catch.try);
+	fold_arg_list(e->e.catch.codes);
+	if (e->e.catch.except)
+	    fold_expr(e->e.catch.except);
+	break;
+
+    case EXPR_SCATTER:
+	for (sc = e->e.scatter; sc; sc = sc->next)
+	    if (sc->expr)
+		fold_expr(sc->expr);
+	break;
+
+    default:
+	break;
+    }
+}
+
+static void
+free_arms(Cond_Arm * arm)
+{
+    Cond_Arm *next;
+
+    for (; arm; arm = next) {
+	next = arm->next;
+	free_expr(arm->condition);
+	free_stmt(arm->stmt);
+	myfree(arm, M_AST);
+    }
+}
+
+static Stmt *fold_stmts(Stmt *);
+
+/* Folds STMT, which is not linked to any others, and returns the (possibly
+ * empty) list of statements to put in its place.
+ */
+static Stmt *
+fold_stmt(Stmt * stmt)
+{
+    Cond_Arm **armp, *arm;
+    Except_Arm *ex;
+    Stmt *body;
+
+    switch (stmt->kind) {
+    case STMT_COND:
+	for (armp = &stmt->s.cond.arms; (arm = *armp);) {
+	    fold_expr(arm->condition);
+	    if (!is_literal(arm->condition)) {
+		arm->stmt = fold_stmts(arm->stmt);
+		armp = &arm->next;
+	    } else if (is_true(arm->condition->e.var)) {
+		/* Always taken when reached: it is the else from here on. */
+		free_arms(arm->next);
+		free_stmt(stmt->s.cond.otherwise);
+		stmt->s.cond.otherwise = arm->stmt;
+		arm->next = 0;
+		arm->stmt = 0;
+		free_arms(arm);
+		*armp = 0;
+	    } else {
+		*armp = arm->next;
+		arm->next = 0;
+		free_arms(arm);
+	    }
+	}
+	stmt->s.cond.otherwise = fold_stmts(stmt->s.cond.otherwise);
+	if (!stmt->s.cond.arms) {
+	    body = stmt->s.cond.otherwise;
+	    stmt->s.cond.otherwise = 0;
+	    free_stmt(stmt);
+	    return body;
+	}
+	break;
+
+    case STMT_LIST:
+	fold_expr(stmt->s.list.expr);
+	stmt->s.list.body = fold_stmts(stmt->s.list.body);
+	break;
+
+    case STMT_RANGE:
+	fold_expr(stmt->s.range.from);
+	fold_expr(stmt->s.range.to);
+	stmt->s.range.body = fold_stmts(stmt->s.range.body);
+	break;
+
+    case STMT_WHILE:
+	fold_expr(stmt->s.loop.condition);
+	if (stmt->s.loop.id == -1 && is_literal(stmt->s.loop.condition)
+	    && !is_true(stmt->s.loop.condition->e.var)) {
+	    free_stmt(stmt);
+	    return 0;
+	}
+	stmt->s.loop.body = fold_stmts(stmt->s.loop.body);
+	break;
+
+    case STMT_FORK:
+	fold_expr(stmt->s.fork.time);
+	stmt->s.fork.body = fold_stmts(stmt->s.fork.body);
+	break;
+
+    case STMT_EXPR:
+    case STMT_RETURN:
+	if (stmt->s.expr)
+	    fold_expr(stmt->s.expr);
+	break;
+
+    case STMT_TRY_EXCEPT:
+	stmt->s.catch.body = fold_stmts(stmt->s.catch.body);
+	for (ex = stmt->s.catch.excepts; ex; ex = ex->next) {
+	    fold_arg_list(ex->codes);
+	    ex->stmt = fold_stmts(ex->stmt);
+	}
+	break;
+
+    case STMT_TRY_FINALLY:
+	stmt->s.finally.body = fold_stmts(stmt->s.finally.body);
+	stmt->s.finally.handler = fold_stmts(stmt->s.finally.handler);
+	break;
+
+    case STMT_BREAK:
+    case STMT_CONTINUE:
+	break;
+    }
+
+    return stmt;
+}
+
+static Stmt *
+fold_stmts(Stmt * stmt)
+{
+    Stmt *head = 0, **tail = &head, *next, *last;
+
+    for (; stmt; stmt = next) {
+	next = stmt->next;
+	stmt->next = 0;
+	last = 0;
+	for (*tail = fold_stmt(stmt); *tail; tail = &(*tail)->next)
+	    last = *tail;
+	if (last && (last->kind == STMT_RETURN || last->kind == STMT_BREAK
+		     || last->kind == STMT_CONTINUE)) {
+	    free_stmt(next);
+	    break;
+	}
+    }
+
+    return head;
+}
+
+Stmt *
+optimize_program(Stmt * stmt)
+{
+    return fold_stmts(stmt);
+}
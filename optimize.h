@@ -0,0 +1,37 @@
+/******************************************************************************
+  Copyright (c) 1992, 1995, 1996 Xerox Corporation.  All rights reserved.
+  Portions of this code were written by Stephen White, aka ghond.
+  Use and copying of this software and preparation of derivative works based
+  upon this software are permitted.  Any distribution of this software or
+  derivative works must comply with all applicable United States export
+  control laws.  This software is made available AS IS, and Xerox Corporation
+  makes no warranty about the software, its performance or its conformity to
+  any specification.  Any person obtaining a copy of this software is requested
+  to send their name and post office or electronic mail address to:
+    Pavel Curtis
+    Xerox PARC
+    3333 Coyote Hill Rd.
+    Palo Alto, CA 94304
+    Pavel@Xerox.Com
+ *****************************************************************************/
+
+/* Constant folding and dead-code elimination over a parsed verb, run
+ * between parsing and code generation when CONSTANT_FOLDING is defined.
+ *
+ * Since verb source is what the decompiler makes of the bytecode, the
+ * folded tree is also what verb_code() lists: `x = 60 * 60' reads back
+ * as `x = 3600', and a branch that can never run is simply gone.
+ */
+
+#ifndef Optimize_H
+#define Optimize_H 1
+
+#include "ast.h"
+
+extern Stmt *optimize_program(Stmt *);
+				/* Rewrites the statement list in place and
+				 * returns its new head, freeing whatever it
+				 * drops; call it after end_code_allocation().
+				 */
+
+#endif		/* !Optimize_H */
@@ -37,6 +37,7 @@
 #include "log.h"
 #include "numbers.h"
 #include "opcode.h"
+#include "optimize.h"
 #include "program.h"
 #include "storage.h"
 #include "streams.h"
@@ -1256,6 +1257,9 @@ parse_program(DB_Version version, Parser_Client c, void *data)
 	    }
 	}
 
+#ifdef CONSTANT_FOLDING
+	prog_start = optimize_program(prog_start);
+#endif
 	prog = generate_code(prog_start, version);
 	prog->num_var_names = local_names->size;
 	prog->var_names = local_names->names;
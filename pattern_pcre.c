@@ -25,6 +25,15 @@
 # define MATCH_LIMIT            100000
 # define MATCH_LIMIT_RECURSION    5000
 
+/* PCRE 8.20 and later can compile patterns to machine code. */
+# ifdef PCRE_STUDY_JIT_COMPILE
+#  define STUDY_OPTIONS  PCRE_STUDY_JIT_COMPILE
+#  define FREE_STUDY(x)  pcre_free_study(x)
+# else
+#  define STUDY_OPTIONS  0
+#  define FREE_STUDY(x)  pcre_free(x)
+# endif
+
 typedef struct {
     pcre *code;
     pcre_extra *extra;
@@ -279,9 +288,10 @@ Pattern new_pattern(const char *pattern, int case_matters)
 	/*
 	 * It would be nice to call pcre_study() only if the pattern is used
 	 * more than once, but we need the pcre_extra block in any case and
-	 * it's difficult to merge the study data later.
+	 * it's difficult to merge the study data later.  Since compiled
+	 * patterns are cached, JIT-compiling them is usually worth it.
 	 */
-	extra = pcre_study(code, 0, &error);
+	extra = pcre_study(code, STUDY_OPTIONS, &error);
 # if DEBUG
 	if (error)
 	    fprintf(stderr, __FILE__ ": pcre_study() failed: %s\n", error);
@@ -402,7 +412,7 @@ void free_pattern(Pattern p)
     regexp_t *regexp = p.ptr;
 
     if (regexp) {
-	pcre_free(regexp->extra);
+	FREE_STUDY(regexp->extra);
 	pcre_free(regexp->code);
 
 	myfree(regexp, M_PATTERN);
@@ -0,0 +1,376 @@
+/******************************************************************************
+  Copyright (c) 1992, 1995, 1996 Xerox Corporation.  All rights reserved.
+  Portions of this code were written by Stephen White, aka ghond.
+  Use and copying of this software and preparation of derivative works based
+  upon this software are permitted.  Any distribution of this software or
+  derivative works must comply with all applicable United States export
+  control laws.  This software is made available AS IS, and Xerox Corporation
+  makes no warranty about the software, its performance or its conformity to
+  any specification.  Any person obtaining a copy of this software is requested
+  to send their name and post office or electronic mail address to:
+    Pavel Curtis
+    Xerox PARC
+    3333 Coyote Hill Rd.
+    Palo Alto, CA 94304
+    Pavel@Xerox.Com
+ *****************************************************************************/
+
+/* Verb profiler; see profile.h.
+ */
+
+#include "profile.h"
+#include "bf_register.h"
+
+#include "my-stdio.h"
+#include "my-string.h"
+#include <errno.h>
+
+#include "functions.h"
+#include "list.h"
+#include "storage.h"
+#include "streams.h"
+#include "timers.h"
+#include "utils.h"
+
+int profile_interval = 0;
+
+/* Where profile_dump() writes, relative to the server's directory.  The
+ * format is the "folded stacks" one read by flamegraph.pl and friends:
+ * one line per distinct stack, frames separated by `;', then the ticks.
+ */
+#define PROFILE_DUMP_FILE	"moo-profile.folded"
+
+#define DEFAULT_PROFILE_INTERVAL	100
+
+
+/*********** Per-line counts ***********/
+
+typedef struct Line_Entry Line_Entry;
+
+struct Line_Entry {
+    Line_Entry *next;
+    unsigned hash;
+    Objid definer;
+    const char *verbname;
+    unsigned line;
+    Num calls;
+    Num ticks;
+    uintmax_t wall_nsec;
+    uintmax_t builtin_nsec;
+};
+
+static Line_Entry **line_table = 0;
+static unsigned line_table_size = 0;
+static unsigned n_lines = 0;
+
+static unsigned
+line_hash(Objid definer, const char *verbname, unsigned line)
+{
+    return str_hash(verbname) ^ ((unsigned) definer * 31) ^ (line << 16);
+}
+
+static void
+grow_line_table(void)
+{
+    unsigned new_size = line_table_size ? 2 * line_table_size : 256;
+    Line_Entry **new_table = mymalloc(new_size * sizeof(Line_Entry *),
+				      M_PROFILE);
+    Line_Entry *e, *next;
+    unsigned i;
+
+    memset(new_table, 0, new_size * sizeof(Line_Entry *));
+    for (i = 0; i < line_table_size; i++)
+	for (e = line_table[i]; e; e = next) {
+	    next = e->next;
+	    e->next = new_table[e->hash % new_size];
+	    new_table[e->hash % new_size] = e;
+	}
+    if (line_table)
+	myfree(line_table, M_PROFILE);
+    line_table = new_table;
+    line_table_size = new_size;
+}
+
+static Line_Entry *
+find_line_entry(Objid definer, const char *verbname, unsigned line)
+{
+    unsigned hash = line_hash(definer, verbname, line);
+    Line_Entry *e;
+
+    if (line_table)
+	for (e = line_table[hash % line_table_size]; e; e = e->next)
+	    if (e->hash == hash && e->definer == definer && e->line == line
+		&& !strcmp(e->verbname, verbname))
+		return e;
+
+    if (n_lines >= line_table_size)
+	grow_line_table();
+
+    e = mymalloc(sizeof(Line_Entry), M_PROFILE);
+    e->hash = hash;
+    e->definer = definer;
+    e->verbname = str_ref(verbname);
+    e->line = line;
+    e->calls = e->ticks = 0;
+    e->wall_nsec = e->builtin_nsec = 0;
+    e->next = line_table[hash % line_table_size];
+    line_table[hash % line_table_size] = e;
+    n_lines++;
+    return e;
+}
+
+
+/*********** Per-stack counts (for flame graphs) ***********/
+
+typedef struct Stack_Entry Stack_Entry;
+
+struct Stack_Entry {
+    Stack_Entry *next;
+    unsigned hash;
+    const char *stack;
+    Num ticks;
+};
+
+static Stack_Entry **stack_table = 0;
+static unsigned stack_table_size = 0;
+static unsigned n_stacks = 0;
+
+static void
+grow_stack_table(void)
+{
+    unsigned new_size = stack_table_size ? 2 * stack_table_size : 256;
+    Stack_Entry **new_table = mymalloc(new_size * sizeof(Stack_Entry *),
+				       M_PROFILE);
+    Stack_Entry *e, *next;
+    unsigned i;
+
+    memset(new_table, 0, new_size * sizeof(Stack_Entry *));
+    for (i = 0; i < stack_table_size; i++)
+	for (e = stack_table[i]; e; e = next) {
+	    next = e->next;
+	    e->next = new_table[e->hash % new_size];
+	    new_table[e->hash % new_size] = e;
+	}
+    if (stack_table)
+	myfree(stack_table, M_PROFILE);
+    stack_table = new_table;
+    stack_table_size = new_size;
+}
+
+static Stack_Entry *
+find_stack_entry(const char *stack)
+{
+    unsigned hash = str_hash(stack);
+    Stack_Entry *e;
+
+    if (stack_table)
+	for (e = stack_table[hash % stack_table_size]; e; e = e->next)
+	    if (e->hash == hash && !strcmp(e->stack, stack))
+		return e;
+
+    if (n_stacks >= stack_table_size)
+	grow_stack_table();
+
+    e = mymalloc(sizeof(Stack_Entry), M_PROFILE);
+    e->hash = hash;
+    e->stack = str_dup(stack);
+    e->ticks = 0;
+    e->next = stack_table[hash % stack_table_size];
+    stack_table[hash % stack_table_size] = e;
+    n_stacks++;
+    return e;
+}
+
+static void
+reset_profile(void)
+{
+    Line_Entry *le, *lnext;
+    Stack_Entry *se, *snext;
+    unsigned i;
+
+    for (i = 0; i < line_table_size; i++)
+	for (le = line_table[i]; le; le = lnext) {
+	    lnext = le->next;
+	    free_str(le->verbname);
+	    myfree(le, M_PROFILE);
+	}
+    if (line_table)
+	myfree(line_table, M_PROFILE);
+    line_table = 0;
+    line_table_size = n_lines = 0;
+
+    for (i = 0; i < stack_table_size; i++)
+	for (se = stack_table[i]; se; se = snext) {
+	    snext = se->next;
+	    free_str(se->stack);
+	    myfree(se, M_PROFILE);
+	}
+    if (stack_table)
+	myfree(stack_table, M_PROFILE);
+    stack_table = 0;
+    stack_table_size = n_stacks = 0;
+}
+
+
+/*********** Recording ***********/
+
+static uintmax_t last_sample_nsec;
+
+void
+profile_task_started(void)
+{
+    last_sample_nsec = timer_nsec();
+}
+
+void
+profile_sample(const profile_frame *frames, int nframes)
+{
+    static Stream *s = 0;
+    const profile_frame *top = frames + nframes - 1;
+    uintmax_t now = timer_nsec();
+    Line_Entry *e;
+    int i;
+
+    if (nframes <= 0)
+	return;
+
+    e = find_line_entry(top->definer, top->verbname, top->line);
+    e->ticks += profile_interval;
+    e->wall_nsec += now - last_sample_nsec;
+    last_sample_nsec = now;
+
+    if (!s)
+	s = new_stream(100);
+    for (i = 0; i < nframes; i++)
+	stream_printf(s, "%s#%"PRIdN":%s", i ? ";" : "",
+		      frames[i].definer, frames[i].verbname);
+    find_stack_entry(reset_stream(s))->ticks += profile_interval;
+}
+
+void
+profile_call(Objid definer, const char *verbname)
+{
+    find_line_entry(definer, verbname, 0)->calls++;
+}
+
+void
+profile_builtin(const profile_frame *where, uintmax_t nsec)
+{
+    find_line_entry(where->definer, where->verbname, where->line)
+	->builtin_nsec += nsec;
+}
+
+
+/*********** Built-in functions ***********/
+
+static package
+bf_profile_start(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr)
+{
+    Num interval = (arglist.v.list[0].v.num > 0
+		    ? arglist.v.list[1].v.num
+		    : DEFAULT_PROFILE_INTERVAL);
+
+    free_var(arglist);
+    if (!is_wizard(progr))
+	return make_error_pack(E_PERM);
+    if (interval < 1 || interval > INT32_MAX)
+	return make_error_pack(E_INVARG);
+
+    profile_interval = interval;
+    profile_task_started();
+    return no_var_pack();
+}
+
+static package
+bf_profile_stop(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr)
+{
+    free_var(arglist);
+    if (!is_wizard(progr))
+	return make_error_pack(E_PERM);
+
+    profile_interval = 0;
+    return no_var_pack();
+}
+
+static package
+bf_profile_reset(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr)
+{
+    free_var(arglist);
+    if (!is_wizard(progr))
+	return make_error_pack(E_PERM);
+
+    reset_profile();
+    return no_var_pack();
+}
+
+/* {{definer, verbname, line, calls, ticks, wall_nsec, builtin_nsec}, ...}
+ * Calls are recorded against line 0.
+ */
+static package
+bf_profile_data(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr)
+{
+    Var r, v;
+    Line_Entry *e;
+    unsigned i;
+    int n = 0;
+
+    free_var(arglist);
+    if (!is_wizard(progr))
+	return make_error_pack(E_PERM);
+
+    r = new_list(n_lines);
+    for (i = 0; i < line_table_size; i++)
+	for (e = line_table[i]; e; e = e->next) {
+	    v = new_list(7);
+	    v.v.list[1].type = TYPE_OBJ;
+	    v.v.list[1].v.obj = e->definer;
+	    v.v.list[2].type = TYPE_STR;
+	    v.v.list[2].v.str = str_ref(e->verbname);
+	    v.v.list[3].type = TYPE_INT;
+	    v.v.list[3].v.num = e->line;
+	    v.v.list[4].type = TYPE_INT;
+	    v.v.list[4].v.num = e->calls;
+	    v.v.list[5].type = TYPE_INT;
+	    v.v.list[5].v.num = e->ticks;
+	    v.v.list[6].type = TYPE_INT;
+	    v.v.list[6].v.num = e->wall_nsec;
+	    v.v.list[7].type = TYPE_INT;
+	    v.v.list[7].v.num = e->builtin_nsec;
+	    r.v.list[++n] = v;
+	}
+    return make_var_pack(r);
+}
+
+static package
+bf_profile_dump(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr)
+{
+    FILE *f;
+    Stack_Entry *e;
+    unsigned i;
+    int failed;
+
+    free_var(arglist);
+    if (!is_wizard(progr))
+	return make_error_pack(E_PERM);
+
+    if (!(f = fopen(PROFILE_DUMP_FILE, "w")))
+	return make_raise_pack(E_INVARG, strerror(errno), zero);
+    for (i = 0; i < stack_table_size; i++)
+	for (e = stack_table[i]; e; e = e->next)
+	    fprintf(f, "%s %"PRIdN"\n", e->stack, e->ticks);
+    failed = ferror(f);
+    if (fclose(f) || failed)
+	return make_raise_pack(E_INVARG, strerror(errno), zero);
+
+    return make_int_pack(n_stacks);
+}
+
+void
+register_profile(void)
+{
+    register_function("profile_start", 0, 1, bf_profile_start, TYPE_INT);
+    register_function("profile_stop", 0, 0, bf_profile_stop);
+    register_function("profile_reset", 0, 0, bf_profile_reset);
+    register_function("profile_data", 0, 0, bf_profile_data);
+    register_function("profile_dump", 0, 0, bf_profile_dump);
+}
@@ -0,0 +1,57 @@
+/******************************************************************************
+  Copyright (c) 1992, 1995, 1996 Xerox Corporation.  All rights reserved.
+  Portions of this code were written by Stephen White, aka ghond.
+  Use and copying of this software and preparation of derivative works based
+  upon this software are permitted.  Any distribution of this software or
+  derivative works must comply with all applicable United States export
+  control laws.  This software is made available AS IS, and Xerox Corporation
+  makes no warranty about the software, its performance or its conformity to
+  any specification.  Any person obtaining a copy of this software is requested
+  to send their name and post office or electronic mail address to:
+    Pavel Curtis
+    Xerox PARC
+    3333 Coyote Hill Rd.
+    Palo Alto, CA 94304
+    Pavel@Xerox.Com
+ *****************************************************************************/
+
+/* Verb profiler:  attributes ticks, wall-clock time, calls and time spent
+ * in built-in functions to (definer, verb name, line number).
+ *
+ * Ticks and wall-clock time are sampled; every profile_interval ticks,
+ * run() reports the current activation stack.  Calls and built-in time
+ * are counted exactly.  When profile_interval is zero (the default),
+ * nothing is recorded and the interpreter's only cost is a test of it.
+ */
+
+#ifndef Profile_H
+#define Profile_H 1
+
+#include "config.h"
+#include "structures.h"
+
+typedef struct {
+    Objid definer;
+    const char *verbname;
+    unsigned line;		/* 0 means "the verb as a whole" */
+} profile_frame;
+
+extern int profile_interval;
+
+extern void profile_task_started(void);
+				/* The interpreter is about to start or resume
+				 * a task; wall-clock time since the last
+				 * sample does not belong to it.
+				 */
+
+extern void profile_sample(const profile_frame *frames, int nframes);
+				/* FRAMES[0] is the outermost activation and
+				 * FRAMES[NFRAMES-1] the running one, which is
+				 * charged profile_interval ticks and the time
+				 * since the previous sample.
+				 */
+
+extern void profile_call(Objid definer, const char *verbname);
+extern void profile_builtin(const profile_frame *where, uintmax_t nsec);
+
+#endif		/* !Profile_H */
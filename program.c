@@ -15,6 +15,11 @@
     Pavel@Xerox.Com
  *****************************************************************************/
 
+#include "config.h"
+#include "options.h"
+
+#include "my-string.h"
+
 #include "ast.h"
 #include "exceptions.h"
 #include "list.h"
@@ -31,9 +36,6 @@ new_program(void)
 
     p->ref_count = 1;
     p->first_lineno = 1;
-    p->cached_lineno = 1;
-    p->cached_lineno_pc = 0;
-    p->cached_lineno_vec = MAIN_VECTOR;
     return p;
 }
 
@@ -62,6 +64,125 @@ program_ref(Program * p)
     return p;
 }
 
+/*********** Compiled-program cache ***********/
+
+/* eval() and emergency-mode code tends to run the same short snippets
+ * over and over, so remember the last PROGRAM_CACHE_SIZE successfully
+ * compiled ones, most recently used first.  Programs are never modified
+ * once compiled, so sharing them is just a matter of refcounts.  All
+ * cached programs are compiled at current_db_version.
+ */
+
+struct prog_cache_entry {
+    unsigned hash;
+    Var code;			/* list of strings, or none if unused */
+    Program *program;
+    struct prog_cache_entry *next;
+};
+
+static struct prog_cache_entry *prog_cache;
+static struct prog_cache_entry prog_cache_entries[PROGRAM_CACHE_SIZE];
+static unsigned prog_cache_hits, prog_cache_misses;
+
+static unsigned
+code_hash(Var code)
+{
+    unsigned h = 5381;
+    const char *p;
+    int i;
+
+    for (i = 1; i <= code.v.list[0].v.num; i++) {
+	for (p = code.v.list[i].v.str; *p; p++)
+	    h = h * 33 + (unsigned char) *p;
+	h = h * 33 + '\n';
+    }
+    return h;
+}
+
+static int
+same_code(Var a, Var b)
+{
+    int i;
+
+    if (a.v.list == b.v.list)
+	return 1;
+    if (a.v.list[0].v.num != b.v.list[0].v.num)
+	return 0;
+    for (i = 1; i <= a.v.list[0].v.num; i++)
+	if (strcmp(a.v.list[i].v.str, b.v.list[i].v.str))
+	    return 0;
+    return 1;
+}
+
+Program *
+parse_list_as_cached_program(Var code, Var *errors)
+{
+    struct prog_cache_entry *entry, **entry_ptr;
+    unsigned hash = code_hash(code);
+    int i;
+
+    if (!prog_cache) {
+	for (i = 0; i < PROGRAM_CACHE_SIZE - 1; i++)
+	    prog_cache_entries[i].next = &(prog_cache_entries[i + 1]);
+	prog_cache_entries[PROGRAM_CACHE_SIZE - 1].next = 0;
+	prog_cache = &(prog_cache_entries[0]);
+    }
+
+    entry = prog_cache;
+    entry_ptr = &prog_cache;
+    while (1) {
+	if (entry->program && entry->hash == hash
+	    && same_code(entry->code, code)) {
+	    /* A cache hit; move this entry to the front of the cache. */
+	    prog_cache_hits++;
+	    *errors = new_list(0);
+	    break;
+	} else if (!entry->next) {
+	    /* A cache miss; reuse the last entry iff compilation succeeds. */
+	    Program *program = parse_list_as_program(code, errors);
+
+	    prog_cache_misses++;
+	    if (!program)
+		return 0;
+	    if (entry->program) {
+		free_var(entry->code);
+		free_program(entry->program);
+	    }
+	    entry->hash = hash;
+	    entry->code = var_ref(code);
+	    entry->program = program;
+	    break;
+	} else {
+	    entry_ptr = &(entry->next);
+	    entry = entry->next;
+	}
+    }
+
+    *entry_ptr = entry->next;
+    entry->next = prog_cache;
+    prog_cache = entry;
+    return program_ref(entry->program);
+}
+
+Var
+program_cache_stats(void)
+{
+    Var r = new_list(4);
+    int i, n = 0;
+
+    for (i = 0; i < PROGRAM_CACHE_SIZE; i++)
+	if (prog_cache_entries[i].program)
+	    n++;
+
+    r.v.list[1].type = r.v.list[2].type = TYPE_INT;
+    r.v.list[3].type = r.v.list[4].type = TYPE_INT;
+    r.v.list[1].v.num = prog_cache_hits;
+    r.v.list[2].v.num = prog_cache_misses;
+    r.v.list[3].v.num = n;
+    r.v.list[4].v.num = PROGRAM_CACHE_SIZE;
+    return r;
+}
+
 int
 program_bytes(Program * p)
 {
@@ -69,13 +190,16 @@ program_bytes(Program * p)
 
     count = BQM_SIZEOF(Program);
     count += p->main_vector.size;
+    count += p->main_vector.num_line_runs * sizeof(Line_Run);
 
     for (i = 0; i < p->num_literals; i++)
 	count += value_bytes(p->literals[i]);
 
     count += BQM_SIZEOF(Bytecodes) * p->fork_vectors_size;
-    for (i = 0; i < p->fork_vectors_size; i++)
+    for (i = 0; i < p->fork_vectors_size; i++) {
 	count += p->fork_vectors[i].size;
+	count += p->fork_vectors[i].num_line_runs * sizeof(Line_Run);
+    }
 
     count += BQM_SIZEOF_PTR_TO_CONST(char) * p->num_var_names;
     for (i = 0; i < p->num_var_names; i++)
@@ -93,13 +217,16 @@ free_program(Program * p)
     if (p->ref_count == 0) {
 
 	for (i = 0; i < p->num_literals; i++)
-	    /* can't be a list--strings and floats need to be freed, though. */
+	    /* strings, floats and (folded) lists need to be freed */
 	    free_var(p->literals[i]);
 	if (p->literals)
 	    myfree(p->literals, M_LIT_LIST);
 
-	for (i = 0; i < p->fork_vectors_size; i++)
+	for (i = 0; i < p->fork_vectors_size; i++) {
 	    myfree(p->fork_vectors[i].vector, M_BYTECODES);
+	    if (p->fork_vectors[i].line_runs)
+		myfree(p->fork_vectors[i].line_runs, M_LINE_RUNS);
+	}
 	if (p->fork_vectors_size)
 	    myfree(p->fork_vectors, M_FORK_VECTORS);
 
@@ -108,6 +235,8 @@ free_program(Program * p)
 	myfree(p->var_names, M_NAMES);
 
 	myfree(p->main_vector.vector, M_BYTECODES);
+	if (p->main_vector.line_runs)
+	    myfree(p->main_vector.line_runs, M_LINE_RUNS);
 
 	myfree(p, M_PROGRAM);
     }
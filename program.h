@@ -23,12 +23,22 @@
 
 typedef uint8_t Byte;
 
+/* One entry per run of bytes blamed on the same line, sorted by PC.  LINE
+ * counts from zero at the program's first line; see find_line_number().
+ */
+typedef struct {
+    unsigned pc;
+    unsigned line;
+} Line_Run;
+
 typedef struct {
     Byte numbytes_label, numbytes_literal, numbytes_fork, numbytes_var_name,
      numbytes_stack;
     Byte *vector;
     unsigned size;
     unsigned max_stack;
+    unsigned num_line_runs;
+    Line_Run *line_runs;
 } Bytecodes;
 #define BQM_DESCRIBE_Bytecodes(B,F,V,X)   ((4 * F) + V)
 
@@ -47,10 +57,6 @@ typedef struct {
 
     unsigned num_var_names;
     const char **var_names;
-
-    unsigned cached_lineno;
-    unsigned cached_lineno_pc;
-    int cached_lineno_vec;
 } Program;
 #define BQM_DESCRIBE_Program(B,F,V,X)   ((8 * F) + (9 * V))
 
@@ -62,6 +68,15 @@ extern Program *program_ref(Program *);
 extern int program_bytes(Program *);
 extern void free_program(Program *);
 
+extern Program *parse_list_as_cached_program(Var code, Var * errors);
+				/* Like parse_list_as_program(), but remembers
+				 * recently compiled CODE and shares the
+				 * resulting program.  The caller gets its own
+				 * reference either way.
+				 */
+extern Var program_cache_stats(void);
+				/* {hits, misses, entries, capacity} */
+
 #endif		/* !Program_H */
 
 /*
@@ -71,6 +71,11 @@ static Checkpoint_Reason checkpoint_requested = CHKPT_OFF;
 
 static int checkpoint_finished = 0;	/* 1 = failure, 2 = success */
 
+/* How long the main loop keeps running ready tasks, one after another,
+ * before it goes back to the network.
+ */
+#define TASK_BATCH_NSEC	(10 * 1000000)
+
 typedef struct shandle {
     struct shandle *next, **prev;
     network_handle nhandle;
@@ -481,12 +486,23 @@ main_loop(void)
 	}
 #endif
 
-	if (!network_process_io(seconds_left ? 1 : 0) && seconds_left > 1)
+	if (!network_process_io(seconds_left ? 1 : 0) && seconds_left > 1) {
 	    db_flush(FLUSH_ONE_SECOND);
-	else
+#ifdef LAZY_VERB_COMPILE
+	    /* Nothing else going on; get some verbs compiled. */
+	    db_precompile_verbs(100);
+#endif
+	} else
 	    db_flush(FLUSH_IF_FULL);
 
-	run_ready_tasks();
+	{			/* Run a batch of ready tasks */
+	    uintmax_t start = timer_nsec();
+
+	    while (run_ready_tasks() && !shutdown_message
+		   && checkpoint_requested == CHKPT_OFF
+		   && timer_nsec() - start < TASK_BATCH_NSEC)
+		;
+	}
 
 	{			/* Get rid of old un-logged-in or useless connections */
 	    int now = time(0);
@@ -745,7 +761,7 @@ emergency_mode(void)
 	    str.v.str = str_dup(";");
 	    code = listappend(code, str);
 
-	    program = parse_list_as_program(code, &errors);
+	    program = parse_list_as_cached_program(code, &errors);
 	    free_var(code);
 	    if (program) {
 		Var result;
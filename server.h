@@ -206,7 +206,19 @@ extern int get_server_option(Objid oid, const char *name, Var * r);
 								\
   DEFINE( SVO_MAX_CONCAT_CATCHABLE, max_concat_catchable,	\
 	  flag, 0, /* already canonical */			\
-	  )
+	  )							\
+								\
+  DEFINE( SVO_FUNCTION_STATS, function_stats,			\
+	  flag, 0, /* already canonical */			\
+	  )							\
+								\
+  DEFINE( SVO_PATTERN_CACHE_SIZE, pattern_cache_size,		\
+								\
+	  int, PATTERN_CACHE_SIZE,				\
+	 _STATEMENT({						\
+	     if (value < 1)					\
+		 value = PATTERN_CACHE_SIZE;			\
+	   }))
 
 /* List of all category (2) and (3) cached server options */
 enum Server_Option {
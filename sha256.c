@@ -0,0 +1,173 @@
+/******************************************************************************
+  Copyright (c) 1996 Xerox Corporation.  All rights reserved.
+  Use and copying of this software and preparation of derivative works based
+  upon this software are permitted.  Any distribution of this software or
+  derivative works must comply with all applicable United States export
+  control laws.  This software is made available AS IS, and Xerox Corporation
+  makes no warranty about the software, its performance or its conformity to
+  any specification.  Any person obtaining a copy of this software is requested
+  to send their name and post office or electronic mail address to:
+    Pavel Curtis
+    Xerox PARC
+    3333 Coyote Hill Rd.
+    Palo Alto, CA 94304
+    Pavel@Xerox.Com
+ *****************************************************************************/
+
+/* sha256.c
+   SHA-256 Secure Hash Algorithm, as specified in FIPS 180-4.
+ */
+
+#include "my-string.h"
+
+#include "sha256.h"
+
+static const uint32_t K[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+
+#define CH(x, y, z)	(((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z)	(((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define BSIG0(x)	(ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define BSIG1(x)	(ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+#define SSIG0(x)	(ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))
+#define SSIG1(x)	(ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))
+
+/*
+ * SHA-256 basic transformation. Transforms state based on block.
+ */
+static void
+sha256_Transform(uint32_t state[8], const uint8_t block[64])
+{
+    uint32_t a, b, c, d, e, f, g, h, t1, t2, w[64];
+    int i;
+
+    for (i = 0; i < 16; i++)
+	w[i] = ((uint32_t) block[4 * i] << 24)
+	    | ((uint32_t) block[4 * i + 1] << 16)
+	    | ((uint32_t) block[4 * i + 2] << 8)
+	    | (uint32_t) block[4 * i + 3];
+    for (; i < 64; i++)
+	w[i] = SSIG1(w[i - 2]) + w[i - 7] + SSIG0(w[i - 15]) + w[i - 16];
+
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+    e = state[4];
+    f = state[5];
+    g = state[6];
+    h = state[7];
+
+    for (i = 0; i < 64; i++) {
+	t1 = h + BSIG1(e) + CH(e, f, g) + K[i] + w[i];
+	t2 = BSIG0(a) + MAJ(a, b, c);
+	h = g;
+	g = f;
+	f = e;
+	e = d + t1;
+	d = c;
+	c = b;
+	b = a;
+	a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+/*
+ * SHA-256 initialization. Begins an SHA-256 operation, writing a new context.
+ */
+void
+sha256_Init(sha256ctx_t * context)
+{
+    context->count = 0;
+    context->state[0] = 0x6a09e667;
+    context->state[1] = 0xbb67ae85;
+    context->state[2] = 0x3c6ef372;
+    context->state[3] = 0xa54ff53a;
+    context->state[4] = 0x510e527f;
+    context->state[5] = 0x9b05688c;
+    context->state[6] = 0x1f83d9ab;
+    context->state[7] = 0x5be0cd19;
+}
+
+/*
+ * SHA-256 block update operation. Continues an SHA-256 message-digest
+ * operation, processing another message block, and updating the context.
+ */
+void
+sha256_Update(sha256ctx_t * context, const uint8_t * buf, unsigned len)
+{
+    unsigned index = (unsigned) (context->count & 0x3F);
+    unsigned partLen = 64 - index;
+
+    context->count += len;
+
+    if (index && len >= partLen) {
+	memcpy(context->buffer + index, buf, partLen);
+	sha256_Transform(context->state, context->buffer);
+	buf += partLen;
+	len -= partLen;
+	index = 0;
+    }
+    if (!index)
+	for (; len >= 64; buf += 64, len -= 64)
+	    sha256_Transform(context->state, buf);
+
+    memcpy(context->buffer + index, buf, len);
+}
+
+/*
+ * SHA-256 finalization. Ends an SHA-256 message-digest operation, writing
+ * the message digest and zeroizing the context.
+ */
+void
+sha256_Final(sha256ctx_t * context, uint8_t digest[32])
+{
+    uint64_t bits = context->count * 8;
+    uint8_t pad[72];
+    unsigned index = (unsigned) (context->count & 0x3F);
+    unsigned padLen = (index < 56) ? (56 - index) : (120 - index);
+    int i;
+
+    memset(pad, 0, sizeof(pad));
+    pad[0] = 0x80;
+    for (i = 0; i < 8; i++)
+	pad[padLen + i] = (uint8_t) (bits >> (56 - 8 * i));
+    sha256_Update(context, pad, padLen + 8);
+
+    for (i = 0; i < 8; i++) {
+	digest[4 * i] = (uint8_t) (context->state[i] >> 24);
+	digest[4 * i + 1] = (uint8_t) (context->state[i] >> 16);
+	digest[4 * i + 2] = (uint8_t) (context->state[i] >> 8);
+	digest[4 * i + 3] = (uint8_t) context->state[i];
+    }
+
+    memset(context, 0, sizeof(*context));
+}
@@ -0,0 +1,38 @@
+/******************************************************************************
+  Copyright (c) 1996 Xerox Corporation.  All rights reserved.
+  Use and copying of this software and preparation of derivative works based
+  upon this software are permitted.  Any distribution of this software or
+  derivative works must comply with all applicable United States export
+  control laws.  This software is made available AS IS, and Xerox Corporation
+  makes no warranty about the software, its performance or its conformity to
+  any specification.  Any person obtaining a copy of this software is requested
+  to send their name and post office or electronic mail address to:
+    Pavel Curtis
+    Xerox PARC
+    3333 Coyote Hill Rd.
+    Palo Alto, CA 94304
+    Pavel@Xerox.Com
+ *****************************************************************************/
+
+/* sha256.h
+   SHA-256 Secure Hash Algorithm (FIPS 180-4), with the same interface
+   as md5.h.
+ */
+
+#ifndef SHA256_h
+#define SHA256_h 1
+
+#include "config.h"
+
+/* SHA-256 context. */
+typedef struct {
+    uint32_t state[8];		/* state (A..H) */
+    uint64_t count;		/* number of bytes hashed so far */
+    uint8_t buffer[64];		/* input buffer */
+} sha256ctx_t;
+
+void sha256_Init(sha256ctx_t * context);
+void sha256_Update(sha256ctx_t * context, const uint8_t * buf, unsigned len);
+void sha256_Final(sha256ctx_t * context, uint8_t digest[32]);
+
+#endif		/* !SHA256_h */
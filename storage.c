@@ -30,6 +30,7 @@
 #include "utils.h"
 
 static unsigned alloc_num[Sizeof_Memory_Type];
+uintmax_t bytes_allocated = 0;
 
 static inline int
 refcount_overhead(Memory_Type type)
@@ -80,6 +81,7 @@ mymalloc(unsigned size, Memory_Type type)
 	panic(msg);
     }
     alloc_num[type]++;
+    bytes_allocated += size;
 
     if (offs) {
 	memptr += offs;
@@ -131,6 +133,7 @@ myrealloc(void *ptr, unsigned size, Memory_Type type)
 	sprintf(msg, "memory re-allocation (size %u) failed!", size);
 	panic(msg);
     }
+    bytes_allocated += size;
     return (char *) ptr + offs;
 }
 
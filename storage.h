@@ -26,23 +26,29 @@
 typedef enum Memory_Type {
     M_AST_POOL, M_AST, M_PROGRAM, M_PVAL, M_NETWORK, M_STRING, M_VERBDEF,
     M_LIST, M_PREP, M_PROPDEF, M_OBJECT_TABLE, M_OBJECT, M_FLOAT,
-    M_STREAM, M_NAMES, M_ENV, M_TASK, M_PATTERN,
+    M_STREAM, M_NAMES, M_ENV, M_TASK, M_PATTERN, M_LIST_INDEX,
 
-    M_BYTECODES, M_FORK_VECTORS, M_LIT_LIST,
+    M_BYTECODES, M_FORK_VECTORS, M_LIT_LIST, M_LINE_RUNS,
     M_PROTOTYPE, M_CODE_GEN, M_DISASSEMBLE, M_DECOMPILE,
 
     M_RT_STACK, M_RT_ENV, M_BI_FUNC_DATA, M_VM,
 
     M_REF_ENTRY, M_REF_TABLE, M_VC_ENTRY, M_VC_TABLE, M_STRING_PTRS,
+    M_OWNED_ENTRY, M_OWNED_TABLE, M_PROFILE,
     M_INTERN_POINTER, M_INTERN_ENTRY, M_INTERN_HUNK,
 
-    M_XML_DATA,
+    M_XML_DATA, M_JSON_DATA,
     M_WAIF, M_WAIF_XTRA,
 
     Sizeof_Memory_Type
 
 } Memory_Type;
 
+extern uintmax_t bytes_allocated;
+				/* Running total of bytes ever requested from
+				 * mymalloc()/myrealloc(); never decreases.
+				 */
+
 extern char *str_dup(const char *);
 extern const char *str_ref(const char *);
 extern Var memory_usage(void);
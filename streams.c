@@ -186,13 +186,11 @@ stream_add_bytes(Stream * s, const char *bytes, size_t len)
 }
 
 void
-stream_printf(Stream * s, const char *fmt,...)
+stream_vprintf(Stream * s, const char *fmt, va_list args)
 {
-    va_list args, pargs;
+    va_list pargs;
     ssize_t len;
 
-    va_start(args, fmt);
-
     va_copy(pargs, args);
     len = vsnprintf(s->buffer + s->current, s->buflen - s->current,
 		    fmt, pargs);
@@ -204,10 +202,19 @@ stream_printf(Stream * s, const char *fmt,...)
     if (grew(s, len))
 	len = vsnprintf(s->buffer + s->current, s->buflen - s->current,
 			fmt, args);
-    va_end(args);
     s->current += len;
 }
 
+void
+stream_printf(Stream * s, const char *fmt,...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    stream_vprintf(s, fmt, args);
+    va_end(args);
+}
+
 void
 free_stream(Stream * s)
 {
@@ -21,6 +21,7 @@
 #include "config.h"
 #include "options.h"
 
+#include "my-stdarg.h"
 #include "my-string.h"
 
 #include "exceptions.h"
@@ -66,6 +67,7 @@ extern void stream_add_bytes(Stream *, const char *, size_t);
 inline void stream_add_string(Stream * s, const char *string)
 { stream_add_bytes(s, string, strlen(string)); }
 extern void stream_printf(Stream *, const char *,...) FORMAT(printf,2,3);
+extern void stream_vprintf(Stream *, const char *, va_list) FORMAT(printf,2,0);
 
 extern void stream_unparse_float(Stream *, FlNum, int);
 /* last argument is boolean:  true iff for tostr() */
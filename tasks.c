@@ -80,7 +80,10 @@ typedef struct {
 } input_task;
 
 typedef struct task {
-    struct task *next;
+    struct task *next, **prev;	/* prev only valid on waiting_tasks and
+				 * bg lists */
+    struct task *next_by_id;	/* chain in task_index */
+    struct tqueue *bg_tq;	/* queue whose bg list holds this, if any */
     task_kind kind;
     union {
 	input_task input;
@@ -173,9 +176,20 @@ typedef struct ext_queue {
 
 #define NO_USAGE	-1
 
+/* Freed task structs kept for reuse, since forks and suspends make and
+ * free them constantly.
+ */
+#define TASK_POOL_DEPTH	256
+
 TaskID current_task_id;
 static tqueue *idle_tqueues = 0, *active_tqueues = 0;
 static task *waiting_tasks = 0;	/* forked and suspended tasks */
+static task **waiting_last = &waiting_tasks;
+/* NEXT is a task's first member, so a pointer to some task's NEXT field
+ * (such as WAITING_LAST, or any task's PREV but the first's) points to
+ * that task.
+ */
+#define NEXT_TO_TASK(tt)	((task *) (tt))
 static ext_queue *external_queues = 0;
 
 #define GET_START_TIME(ttt) \
@@ -183,6 +197,11 @@ static ext_queue *external_queues = 0;
      ? ttt->t.forked.start_time \
      : ttt->t.suspended.start_time)
 
+#define GET_TASK_ID(ttt) \
+    (ttt->kind == TASK_FORKED \
+     ? ttt->t.forked.id \
+     : ttt->t.suspended.the_vm->task_id)
+
 
 /*
  *  ICMD_FOR_EACH(DEFINE,verb)
@@ -390,12 +409,106 @@ free_tqueue(tqueue * tq)
     myfree(tq, M_TASK);
 }
 
+/*********** Task-id index ***********/
+
+/* Every forked or suspended task on waiting_tasks or on some tqueue's bg
+ * list is also hashed here by its id, so that kill_task(), resume() and
+ * task_stack() don't have to search every queue.  Tasks join the index when
+ * they are first queued and leave it when they are dequeued to run or are
+ * killed; moving between waiting_tasks and a bg list doesn't affect it.
+ */
+
+static task **task_index = 0;
+static unsigned task_index_size = 0;
+static unsigned num_indexed_tasks = 0;
+
+#define TASK_HASH(id)	((unsigned) num_from_task_id(id))
+
+static void
+grow_task_index(void)
+{
+    unsigned new_size = task_index_size ? 2 * task_index_size : 256;
+    task **new_index = mymalloc(new_size * sizeof(task *), M_TASK);
+    task *t, *next;
+    unsigned i;
+
+    memset(new_index, 0, new_size * sizeof(task *));
+    for (i = 0; i < task_index_size; i++)
+	for (t = task_index[i]; t; t = next) {
+	    next = t->next_by_id;
+	    t->next_by_id = new_index[TASK_HASH(GET_TASK_ID(t)) % new_size];
+	    new_index[TASK_HASH(GET_TASK_ID(t)) % new_size] = t;
+	}
+    if (task_index)
+	myfree(task_index, M_TASK);
+    task_index = new_index;
+    task_index_size = new_size;
+}
+
+static void
+index_task(task * t)
+{
+    unsigned h;
+
+    if (num_indexed_tasks >= task_index_size)
+	grow_task_index();
+    h = TASK_HASH(GET_TASK_ID(t)) % task_index_size;
+    t->next_by_id = task_index[h];
+    task_index[h] = t;
+    num_indexed_tasks++;
+}
+
+static void
+unindex_task(task * t)
+{
+    task **tt = &(task_index[TASK_HASH(GET_TASK_ID(t)) % task_index_size]);
+
+    for (; *tt; tt = &((*tt)->next_by_id))
+	if (*tt == t) {
+	    *tt = t->next_by_id;
+	    num_indexed_tasks--;
+	    return;
+	}
+    panic("Task not in index in UNINDEX_TASK()");
+}
+
+static task *
+find_indexed_task(TaskID id)
+{
+    task *t;
+
+    if (!task_index)
+	return 0;
+    for (t = task_index[TASK_HASH(id) % task_index_size]; t;
+	 t = t->next_by_id)
+	if (GET_TASK_ID(t) == id)
+	    return t;
+    return 0;
+}
+
+/* Remove T from waiting_tasks or from its bg list. */
+static void
+unlink_task(task * t)
+{
+    if (t->bg_tq && t->bg_tq->last_bg == &(t->next))
+	t->bg_tq->last_bg = t->prev;
+    else if (!t->bg_tq && waiting_last == &(t->next))
+	waiting_last = t->prev;
+    *(t->prev) = t->next;
+    if (t->next)
+	t->next->prev = t->prev;
+    t->next = 0;
+    t->bg_tq = 0;
+}
+
 static void
 enqueue_bg_task(tqueue * tq, task * t)
 {
     *(tq->last_bg) = t;
+    t->prev = tq->last_bg;
     tq->last_bg = &(t->next);
     t->next = 0;
+    t->bg_tq = tq;
 }
 
 static task *
@@ -404,11 +517,7 @@ dequeue_bg_task(tqueue * tq)
     task *t = tq->first_bg;
 
     if (t) {
-	tq->first_bg = t->next;
-	if (t->next == 0)
-	    tq->last_bg = &(tq->first_bg);
-	else
-	    t->next = 0;
+	unlink_task(t);
 	tq->num_bg_tasks--;
     }
     return t;
@@ -483,6 +592,34 @@ dequeue_input_task(tqueue * tq, enum dequeue_how how)
     return t;
 }
 
+static task *free_tasks = 0;
+static unsigned num_free_tasks = 0;
+
+static task *
+alloc_task(void)
+{
+    task *t = free_tasks;
+
+    if (t) {
+	free_tasks = t->next;
+	num_free_tasks--;
+    } else
+	t = mymalloc(sizeof(task), M_TASK);
+
+    return t;
+}
+
+static void
+dealloc_task(task * t)
+{
+    if (num_free_tasks < TASK_POOL_DEPTH) {
+	t->next = free_tasks;
+	free_tasks = t;
+	num_free_tasks++;
+    } else
+	myfree(t, M_TASK);
+}
+
 static void
 free_task(task * t, int strong)
 {				/* for FORKED tasks, strong == 1 means free the rt_env also.
@@ -514,7 +651,7 @@ free_task(task * t, int strong)
 	    free_vm(t->t.suspended.the_vm, 1);
 	break;
     }
-    myfree(t, M_TASK);
+    dealloc_task(t);
 }
 
 static TaskID
@@ -901,7 +1038,7 @@ enqueue_input_task(tqueue * tq, const char *input, int at_front, int binary)
     static char oob_prefix[] = OUT_OF_BAND_PREFIX;
     task *t;
 
-    t = (task *) mymalloc(sizeof(task), M_TASK);
+    t = alloc_task();
     if (binary)
 	t->kind = TASK_BINARY;
     else if (oob_quote_prefix_length > 0
@@ -1011,26 +1148,34 @@ enqueue_waiting(task * t)
 		   : progr_of_cur_verb(t->t.suspended.the_vm));
     tqueue *tq = find_tqueue(progr, 1);
 
-    tq->num_bg_tasks++;
-    if (!waiting_tasks || start_time < GET_START_TIME(waiting_tasks)) {
-	t->next = waiting_tasks;
-	waiting_tasks = t;
-    } else {
-	task *tt;
+    task **tt;
 
-	for (tt = waiting_tasks; tt->next; tt = tt->next)
-	    if (start_time < GET_START_TIME(tt->next))
-		break;
-	t->next = tt->next;
-	tt->next = t;
-    }
+    tq->num_bg_tasks++;
+    /* Most tasks start no earlier than all but a few tasks already waiting
+     * (think of suspend(0) or fork (0), against suspend() forever), so
+     * look for the spot from the end of the list.
+     */
+    for (tt = waiting_last;
+	 tt != &waiting_tasks
+	 && start_time < GET_START_TIME(NEXT_TO_TASK(tt));
+	 tt = NEXT_TO_TASK(tt)->prev)
+	;
+    t->next = *tt;
+    t->prev = tt;
+    if (t->next)
+	t->next->prev = &(t->next);
+    *tt = t;
+    if (!t->next)
+	waiting_last = &(t->next);
+    t->bg_tq = 0;
+    index_task(t);
 }
 
 static void
 enqueue_ft(Program * program, activation a, Var * rt_env,
 	   int f_index, time_t start_time, TaskID id)
 {
-    task *t = (task *) mymalloc(sizeof(task), M_TASK);
+    task *t = alloc_task();
 
     t->kind = TASK_FORKED;
     t->t.forked.program = program;
@@ -1112,7 +1257,7 @@ enqueue_suspended_task(vm the_vm, void *data)
     task *t;
 
     if (check_user_task_limit(progr_of_cur_verb(the_vm))) {
-	t = mymalloc(sizeof(task), M_TASK);
+	t = alloc_task();
 	t->kind = TASK_SUSPENDED;
 	t->t.suspended.the_vm = the_vm;
 	if (now + after_seconds < now)
@@ -1132,7 +1277,7 @@ enqueue_suspended_task(vm the_vm, void *data)
 void
 resume_task(vm the_vm, Var value)
 {
-    task *t = mymalloc(sizeof(task), M_TASK);
+    task *t = alloc_task();
     Objid progr = progr_of_cur_verb(the_vm);
     tqueue *tq = find_tqueue(progr, 1);
 
@@ -1142,6 +1287,7 @@ resume_task(vm the_vm, Var value)
     t->t.suspended.value = value;
 
     enqueue_bg_task(tq, t);
+    index_task(t);
     ensure_usage(tq);
 }
 
@@ -1161,7 +1307,7 @@ read_input_now(Objid connection)
     } else {
 	r.type = TYPE_STR;
 	r.v.str = t->t.input.string;
-	myfree(t, M_TASK);
+	dealloc_task(t);
     }
 
     return r;
@@ -1210,12 +1356,13 @@ next_task_start(void)
     return -1;
 }
 
-void
+int
 run_ready_tasks(void)
 {
     task *t, *next_t;
     time_t now = time(0);
     tqueue *tq, *next_tq;
+    int did_one = 0;
 
     for (t = waiting_tasks; t && GET_START_TIME(t) <= now; t = next_t) {
 	Objid progr = (t->kind == TASK_FORKED
@@ -1228,9 +1375,12 @@ run_ready_tasks(void)
 	enqueue_bg_task(tq, t);
     }
     waiting_tasks = t;
+    if (t)
+	t->prev = &waiting_tasks;
+    else
+	waiting_last = &waiting_tasks;
 
     {
-	int did_one = 0;
 	time_t start = time(0);
 
 	while (active_tqueues && !did_one) {
@@ -1251,8 +1401,8 @@ run_ready_tasks(void)
 		t = dequeue_input_task(tq, ((tq->hold_input && !tq->reading)
 					    ? DQ_OOB
 					    : DQ_FIRST));
-		if (!t)
-		    t = dequeue_bg_task(tq);
+		if (!t && (t = dequeue_bg_task(tq)) != 0)
+		    unindex_task(t);
 		if (!t)
 		    break;
 
@@ -1329,6 +1479,8 @@ run_ready_tasks(void)
 	if (!tq->connected && !tq->first_input && tq->num_bg_tasks == 0)
 	    free_tqueue(tq);
     }
+
+    return did_one;
 }
 
 enum outcome
@@ -1517,7 +1669,7 @@ read_task_queue(void)
 	return 1;	    /* old version before suspend() existed */
 
     for (; suspended_count > 0; suspended_count--) {
-	task *t = (task *) mymalloc(sizeof(task), M_TASK);
+	task *t = alloc_task();
 	t->kind = TASK_SUSPENDED;
 
 	intmax_t start_time, vtype;
@@ -1796,22 +1948,60 @@ list_for_reading_task(Objid player, vm the_vm)
     return list;
 }
 
+/* queued_tasks([owner [, start [, count]]]) lists the tasks the caller may
+ * see, only those owned by OWNER unless that is #-1, skipping the first
+ * START - 1 of them and stopping after COUNT.  Tasks are always listed in the
+ * same order (reading, ready to run, waiting, then any external queues), so
+ * successive pages line up as long as the queues don't change in between.
+ */
 struct qcl_data {
     Objid progr;
     int show_all;
-    int i;
-    Var tasks;
+    Objid owner;
+    Num skip;			/* matching tasks still to pass over */
+    Num limit;			/* matching tasks still wanted, or -1 */
+    int count, max;
+    Var *tasks;
 };
 
-static task_enum_action
-counting_closure(vm the_vm, const char *status UNUSED_, void *data)
+#define LISTING_DONE(qdata)	((qdata)->limit == 0)
+
+static int
+want_task(struct qcl_data *qdata, Objid owner)
 {
-    struct qcl_data *qdata = data;
+    if ((!qdata->show_all && owner != qdata->progr)
+	|| (qdata->owner != NOTHING && owner != qdata->owner))
+	return 0;
+    if (qdata->skip > 0) {
+	qdata->skip--;
+	return 0;
+    }
+    return 1;
+}
 
-    if (qdata->show_all || qdata->progr == progr_of_cur_verb(the_vm))
-	qdata->i++;
+static void
+add_task(struct qcl_data *qdata, Var list)
+{
+    if (qdata->count == qdata->max) {
+	qdata->max *= 2;
+	qdata->tasks = myrealloc(qdata->tasks, qdata->max * sizeof(Var),
+				 M_TASK);
+    }
+    qdata->tasks[qdata->count++] = list;
+    if (qdata->limit > 0)
+	qdata->limit--;
+}
 
-    return TEA_CONTINUE;
+static void
+list_queued_task(struct qcl_data *qdata, task * t)
+{
+    if (t->kind == TASK_FORKED) {
+	if (want_task(qdata, t->t.forked.a.progr))
+	    add_task(qdata, list_for_forked_task(t->t.forked));
+    } else if (t->kind == TASK_SUSPENDED) {
+	if (want_task(qdata, progr_of_cur_verb(t->t.suspended.the_vm)))
+	    add_task(qdata, list_for_suspended_task(t->t.suspended));
+    }
 }
 
 static task_enum_action
@@ -1820,97 +2010,63 @@ listing_closure(vm the_vm, const char *status, void *data)
     struct qcl_data *qdata = data;
     Var list;
 
-    if (qdata->show_all || qdata->progr == progr_of_cur_verb(the_vm)) {
+    if (want_task(qdata, progr_of_cur_verb(the_vm))) {
 	list = list_for_vm(the_vm);
 	list.v.list[2].type = TYPE_STR;
 	list.v.list[2].v.str = str_dup(status);
-	qdata->tasks.v.list[qdata->i++] = list;
+	add_task(qdata, list);
     }
-    return TEA_CONTINUE;
+    return LISTING_DONE(qdata) ? TEA_STOP : TEA_CONTINUE;
 }
 
 static package
 bf_queued_tasks(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr)
 {
+    int nargs = arglist.v.list[0].v.num;
+    Num start = (nargs >= 2 ? arglist.v.list[2].v.num : 1);
     Var tasks;
-    int show_all = is_wizard(progr);
     tqueue *tq;
     task *t;
-    int i, count = 0;
+    int i;
     ext_queue *eq;
     struct qcl_data qdata;
 
-    for (tq = idle_tqueues; tq; tq = tq->next) {
-	if (tq->reading && (show_all || tq->player == progr))
-	    count++;
-    }
-
-    for (tq = active_tqueues; tq; tq = tq->next) {
-	if (tq->reading && (show_all || tq->player == progr))
-	    count++;
-
-	for (t = tq->first_bg; t; t = t->next)
-	    if (show_all
-		|| (t->kind == TASK_FORKED
-		    ? t->t.forked.a.progr == progr
-		    : progr_of_cur_verb(t->t.suspended.the_vm) == progr))
-		count++;
-    }
-
-    for (t = waiting_tasks; t; t = t->next)
-	if (show_all
-	    || (t->kind == TASK_FORKED
-		? t->t.forked.a.progr == progr
-		: progr_of_cur_verb(t->t.suspended.the_vm) == progr))
-	    count++;
-
     qdata.progr = progr;
-    qdata.show_all = show_all;
-    qdata.i = count;
-    for (eq = external_queues; eq; eq = eq->next)
-	(*eq->enumerator) (counting_closure, &qdata);
-    count = qdata.i;
-
-    tasks = new_list(count);
-    i = 1;
-
-    for (tq = idle_tqueues; tq; tq = tq->next) {
-	if (tq->reading && (show_all || tq->player == progr))
-	    tasks.v.list[i++] = list_for_reading_task(tq->player,
-						      tq->reading_vm);
-    }
-
-    for (tq = active_tqueues; tq; tq = tq->next) {
-	if (tq->reading && (show_all || tq->player == progr))
-	    tasks.v.list[i++] = list_for_reading_task(tq->player,
-						      tq->reading_vm);
-
-	for (t = tq->first_bg; t; t = t->next)
-	    if (t->kind == TASK_FORKED && (show_all
-					|| t->t.forked.a.progr == progr))
-		tasks.v.list[i++] = list_for_forked_task(t->t.forked);
-	    else if (t->kind == TASK_SUSPENDED
-		     && (show_all
-		   || progr_of_cur_verb(t->t.suspended.the_vm) == progr))
-		tasks.v.list[i++] = list_for_suspended_task(t->t.suspended);
+    qdata.show_all = is_wizard(progr);
+    qdata.owner = (nargs >= 1 ? arglist.v.list[1].v.obj : NOTHING);
+    qdata.limit = (nargs >= 3 ? arglist.v.list[3].v.num : -1);
+    free_var(arglist);
+    if (start < 1 || (nargs >= 3 && qdata.limit < 0))
+	return make_error_pack(E_INVARG);
+    qdata.skip = start - 1;
+    qdata.count = 0;
+    qdata.max = 16;
+    qdata.tasks = mymalloc(qdata.max * sizeof(Var), M_TASK);
+
+    for (tq = idle_tqueues; tq && !LISTING_DONE(&qdata); tq = tq->next)
+	if (tq->reading && want_task(&qdata, tq->player))
+	    add_task(&qdata, list_for_reading_task(tq->player,
+						   tq->reading_vm));
+
+    for (tq = active_tqueues; tq && !LISTING_DONE(&qdata); tq = tq->next) {
+	if (tq->reading && want_task(&qdata, tq->player))
+	    add_task(&qdata, list_for_reading_task(tq->player,
+						   tq->reading_vm));
+	for (t = tq->first_bg; t && !LISTING_DONE(&qdata); t = t->next)
+	    list_queued_task(&qdata, t);
     }
 
-    for (t = waiting_tasks; t; t = t->next) {
-	if (t->kind == TASK_FORKED && (show_all ||
-				       t->t.forked.a.progr == progr))
-	    tasks.v.list[i++] = list_for_forked_task(t->t.forked);
-	else if (t->kind == TASK_SUSPENDED
-		 && (progr_of_cur_verb(t->t.suspended.the_vm) == progr
-		     || show_all))
-	    tasks.v.list[i++] = list_for_suspended_task(t->t.suspended);
-    }
+    for (t = waiting_tasks; t && !LISTING_DONE(&qdata); t = t->next)
+	list_queued_task(&qdata, t);
 
-    qdata.tasks = tasks;
-    qdata.i = i;
-    for (eq = external_queues; eq; eq = eq->next)
+    for (eq = external_queues; eq && !LISTING_DONE(&qdata); eq = eq->next)
 	(*eq->enumerator) (listing_closure, &qdata);
 
-    free_var(arglist);
+    tasks = new_list(qdata.count);
+    for (i = 0; i < qdata.count; i++)
+	tasks.v.list[i + 1] = qdata.tasks[i];
+    myfree(qdata.tasks, M_TASK);
+
     return make_var_pack(tasks);
 }
 
@@ -1939,24 +2095,17 @@ find_suspended_task(TaskID id)
     ext_queue *eq;
     struct fcl_data fdata;
 
-    for (t = waiting_tasks; t; t = t->next)
-	if (t->kind == TASK_SUSPENDED && t->t.suspended.the_vm->task_id == id)
-	    return t->t.suspended.the_vm;
+    if ((t = find_indexed_task(id)) != 0)
+	return t->kind == TASK_SUSPENDED ? t->t.suspended.the_vm : 0;
 
     for (tq = idle_tqueues; tq; tq = tq->next)
 	if (tq->reading && tq->reading_vm->task_id == id)
 	    return tq->reading_vm;
 
-    for (tq = active_tqueues; tq; tq = tq->next) {
+    for (tq = active_tqueues; tq; tq = tq->next)
 	if (tq->reading && tq->reading_vm->task_id == id)
 	    return tq->reading_vm;
 
-	for (t = tq->first_bg; t; t = t->next)
-	    if (t->kind == TASK_SUSPENDED
-		&& t->t.suspended.the_vm->task_id == id)
-		return t->t.suspended.the_vm;
-    }
-
     fdata.id = id;
 
     for (eq = external_queues; eq; eq = eq->next)
@@ -1997,30 +2146,24 @@ killing_closure(vm the_vm, const char *status UNUSED_, void *data)
 static enum error
 kill_task(TaskID id, Objid owner)
 {
-    task **tt;
+    task *t;
     tqueue *tq;
 
     if (id == current_task_id) {
 	return E_NONE;
     }
-    for (tt = &waiting_tasks; *tt; tt = &((*tt)->next)) {
-	task *t = *tt;
-	Objid progr;
-
-	if (t->kind == TASK_FORKED && t->t.forked.id == id)
-	    progr = t->t.forked.a.progr;
-	else if (t->kind == TASK_SUSPENDED
-		 && t->t.suspended.the_vm->task_id == id)
-	    progr = progr_of_cur_verb(t->t.suspended.the_vm);
-	else
-	    continue;
+    if ((t = find_indexed_task(id)) != 0) {
+	Objid progr = (t->kind == TASK_FORKED
+		       ? t->t.forked.a.progr
+		       : progr_of_cur_verb(t->t.suspended.the_vm));
 
 	if (!is_wizard(owner) && owner != progr)
 	    return E_PERM;
-	tq = find_tqueue(progr, 0);
+	tq = t->bg_tq ? t->bg_tq : find_tqueue(progr, 0);
 	if (tq)
 	    tq->num_bg_tasks--;
-	*tt = t->next;
+	unlink_task(t);
+	unindex_task(t);
 	free_task(t, 1);
 	return E_NONE;
     }
@@ -2036,7 +2179,6 @@ kill_task(TaskID id, Objid owner)
     }
 
     for (tq = active_tqueues; tq; tq = tq->next) {
-
 	if (tq->reading && tq->reading_vm->task_id == id) {
 	    if (!is_wizard(owner) && owner != tq->player)
 		return E_PERM;
@@ -2044,22 +2186,6 @@ kill_task(TaskID id, Objid owner)
 	    tq->reading = 0;
 	    return E_NONE;
 	}
-	for (tt = &(tq->first_bg); *tt; tt = &((*tt)->next)) {
-	    task *t = *tt;
-
-	    if ((t->kind == TASK_FORKED && t->t.forked.id == id)
-		|| (t->kind == TASK_SUSPENDED
-		    && t->t.suspended.the_vm->task_id == id)) {
-		if (!is_wizard(owner) && owner != tq->player)
-		    return E_PERM;
-		*tt = t->next;
-		if (t->next == 0)
-		    tq->last_bg = tt;
-		tq->num_bg_tasks--;
-		free_task(t, 1);
-		return E_NONE;
-	    }
-	}
     }
 
     {
@@ -2101,47 +2227,28 @@ bf_kill_task(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr)
 static enum error
 do_resume(TaskID id, Var value, Objid progr)
 {
-    task **tt;
+    task *t = find_indexed_task(id);
     tqueue *tq;
+    Objid owner;
 
-    for (tt = &waiting_tasks; *tt; tt = &((*tt)->next)) {
-	task *t = *tt;
-	Objid owner;
-
-	if (t->kind == TASK_SUSPENDED && t->t.suspended.the_vm->task_id == id)
-	    owner = progr_of_cur_verb(t->t.suspended.the_vm);
-	else
-	    continue;
+    if (!t || t->kind != TASK_SUSPENDED)
+	return E_INVARG;
 
-	if (!is_wizard(progr) && progr != owner)
-	    return E_PERM;
+    owner = progr_of_cur_verb(t->t.suspended.the_vm);
+    if (!is_wizard(progr) && progr != owner)
+	return E_PERM;
+    free_var(t->t.suspended.value);
+    t->t.suspended.value = value;
+    if (!t->bg_tq) {
 	t->t.suspended.start_time = time(0);	/* runnable now */
-	free_var(t->t.suspended.value);
-	t->t.suspended.value = value;
 	tq = find_tqueue(owner, 1);
-	*tt = t->next;
+	unlink_task(t);
 	ensure_usage(tq);
 	enqueue_bg_task(tq, t);
-	return E_NONE;
     }
+    /* else already resumed, but we have a new value for it */
 
-    for (tq = active_tqueues; tq; tq = tq->next) {
-	for (tt = &(tq->first_bg); *tt; tt = &((*tt)->next)) {
-	    task *t = *tt;
-
-	    if (t->kind == TASK_SUSPENDED
-		&& t->t.suspended.the_vm->task_id == id) {
-		if (!is_wizard(progr) && progr != tq->player)
-		    return E_PERM;
-		/* already resumed, but we have a new value for it */
-		free_var(t->t.suspended.value);
-		t->t.suspended.value = value;
-		return E_NONE;
-	    }
-	}
-    }
-
-    return E_INVARG;
+    return E_NONE;
 }
 
 static package
@@ -2237,7 +2344,8 @@ void
 register_tasks(void)
 {
     register_function("task_id", 0, 0, bf_task_id);
-    register_function("queued_tasks", 0, 0, bf_queued_tasks);
+    register_function("queued_tasks", 0, 3, bf_queued_tasks,
+		      TYPE_OBJ, TYPE_INT, TYPE_INT);
     register_function("kill_task", 1, 1, bf_kill_task, TYPE_INT);
     register_function("output_delimiters", 1, 1, bf_output_delimiters,
 		      TYPE_OBJ);
@@ -81,7 +81,10 @@ extern void register_task_queue(task_enumerator);
 extern Var read_input_now(Objid connection);
 
 extern int next_task_start(void);
-extern void run_ready_tasks(void);
+extern int run_ready_tasks(void);
+				/* Runs at most one task; returns true if it
+				 * did.
+				 */
 extern enum outcome run_server_task(Objid player, Objid what,
 				    const char *verb, Var args,
 				    const char *argstr, Var * result);
@@ -217,6 +217,22 @@ virtual_timer_available(void)
 #endif
 }
 
+uintmax_t
+timer_nsec(void)
+{
+#if HAVE_CLOCK_GETTIME && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uintmax_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, 0);
+    return (uintmax_t) tv.tv_sec * 1000000000 + tv.tv_usec * 1000;
+#endif
+}
+
 unsigned
 timer_wakeup_interval(Timer_ID id)
 {
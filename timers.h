@@ -18,6 +18,7 @@
 #ifndef Timers_H
 #define Timers_H 1
 
+#include "config.h"
 #include "my-time.h"
 
 typedef int Timer_ID;
@@ -31,6 +32,11 @@ extern void reenable_timers(void);
 extern unsigned timer_wakeup_interval(Timer_ID);
 extern void timer_sleep(unsigned seconds);
 extern int virtual_timer_available(void);
+extern uintmax_t timer_nsec(void);
+				/* A clock for measuring elapsed time, in
+				 * nanoseconds from some arbitrary origin.
+				 * Resolution may be much coarser than that.
+				 */
 
 #endif		/* !Timers_H */
 
@@ -156,6 +156,8 @@ complex_free_var(Var v)
 	if (delref(v.v.list) == 0) {
 	    Var *pv;
 
+	    if (list_indexes_in_use)
+		forget_list_index(v.v.list);
 	    for (i = v.v.list[0].v.num, pv = v.v.list + 1; i > 0; i--, pv++)
 		free_var(*pv);
 	    myfree(v.v.list, M_LIST);
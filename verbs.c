@@ -529,7 +529,7 @@ bf_eval(Var arglist, Byte next, void *data UNUSED_, Objid progr)
 	    p = make_error_pack(E_PERM);
 	} else {
 	    Var errors;
-	    Program *program = parse_list_as_program(arglist, &errors);
+	    Program *program = parse_list_as_cached_program(arglist, &errors);
 
 	    free_var(arglist);
 	    if (program) {
@@ -562,6 +562,13 @@ bf_eval(Var arglist, Byte next, void *data UNUSED_, Objid progr)
     return p;
 }
 
+static package
+bf_eval_cache_stats(Var arglist, Byte next UNUSED_, void *vdata UNUSED_, Objid progr UNUSED_)
+{
+    free_var(arglist);
+    return make_var_pack(program_cache_stats());
+}
+
 void
 register_verbs(void)
 {
@@ -580,6 +587,7 @@ register_verbs(void)
     register_function("set_verb_code", 3, 3, bf_set_verb_code,
 		      TYPE_OBJ, TYPE_ANY, TYPE_LIST);
     register_function("eval", 1, 1, bf_eval, TYPE_STR);
+    register_function("eval_cache_stats", 0, 0, bf_eval_cache_stats);
 }
 
 
@@ -31,6 +31,7 @@
 #include "exceptions.h"
 #include "functions.h"
 #include "log.h"
+#include "ref_count.h"
 #include "storage.h"
 #include "streams.h"
 #include "structures.h"
@@ -42,6 +43,9 @@ static waif_count_type waif_count = 0;
 #define MAP_PROP(Mmap, Mbit) (Mmap)[(Mbit) / 32] |= 1 << ((Mbit) % 32)
 #define N_MAPPABLE_PROPS (WAIF_MAPSZ * 32)
 
+#if HAVE_BUILTIN_POPCOUNT
+#  define count_set_bits(x)  __builtin_popcount(x)
+#else
 static int
 count_set_bits(uint32_t x)
 {
@@ -56,6 +60,93 @@ count_set_bits(uint32_t x)
 
     return i;
 }
+#endif
+
+/* Classes with fewer waif properties than this just get scanned
+ * linearly; the name index isn't worth its space.
+ */
+#define WAIF_INDEX_MIN	8
+
+/* (Re)fill the open-addressed name index that lives after wpd->defs[].
+ * Slots hold indices into defs[] or -1 if empty.  Propdefs earlier
+ * in defs[] are inserted first, so a probe always finds the nearest
+ * definition first, same as the linear scan would.
+ */
+static void
+index_waif_propdefs(WaifPropdefs *wpd)
+{
+    int i;
+
+    if (!wpd->index)
+	return;
+    for (i = 0; i <= wpd->index_mask; ++i)
+	wpd->index[i] = -1;
+    for (i = 0; i < wpd->length; ++i) {
+	unsigned h = (unsigned) wpd->defs[i].hash & wpd->index_mask;
+
+	while (wpd->index[h] >= 0)
+	    h = (h + 1) & wpd->index_mask;
+	wpd->index[h] = i;
+    }
+}
+
+/* Freed waifs and short propval arrays go onto free lists rather than
+ * back to malloc, since waif-heavy code tends to create and discard
+ * lots of them in just a few sizes.  The lists are bounded so that a
+ * burst of garbage doesn't pin memory forever.
+ */
+#define WAIF_POOL_MAX		1024	/* waifs kept for reuse */
+#define PROPVAL_POOL_SIZES	8	/* pool propval arrays up to this long */
+#define PROPVAL_POOL_MAX	256	/* arrays kept for reuse, per length */
+
+static Waif *waif_pool[WAIF_POOL_MAX];
+static int waif_pool_n;
+static Var *propval_pool[PROPVAL_POOL_SIZES][PROPVAL_POOL_MAX];
+static int propval_pool_n[PROPVAL_POOL_SIZES];
+
+static Waif *
+alloc_waif(void)
+{
+    Waif *w;
+
+    if (waif_pool_n == 0)
+	return (Waif *) mymalloc(sizeof(Waif), M_WAIF);
+    w = waif_pool[--waif_pool_n];
+    refcount(w) = 1;
+    return w;
+}
+
+static void
+release_waif(Waif *w)
+{
+    if (waif_pool_n < WAIF_POOL_MAX)
+	waif_pool[waif_pool_n++] = w;
+    else
+	myfree(w, M_WAIF);
+}
+
+static Var *
+get_propvals(int cnt)
+{
+    if (cnt == 0)
+	return NULL;
+    if (cnt <= PROPVAL_POOL_SIZES && propval_pool_n[cnt - 1] > 0)
+	return propval_pool[cnt - 1][--propval_pool_n[cnt - 1]];
+    return (Var *) mymalloc(cnt * sizeof(Var), M_WAIF_XTRA);
+}
+
+/* CNT must be the length P was allocated with. */
+static void
+release_propvals(Var *p, int cnt)
+{
+    if (!p)
+	return;
+    if (cnt > 0 && cnt <= PROPVAL_POOL_SIZES
+	&& propval_pool_n[cnt - 1] < PROPVAL_POOL_MAX)
+	propval_pool[cnt - 1][propval_pool_n[cnt - 1]++] = p;
+    else
+	myfree(p, M_WAIF_XTRA);
+}
 
 void
 free_waif_propdefs(WaifPropdefs *wpd)
@@ -93,7 +184,7 @@ static void
 gen_waif_propdefs(Object *o)
 {
     WaifPropdefs *wpd;
-    int cnt, i;
+    int cnt, i, nslots;
     Object *p;
 
     /* This is a lot like dbpriv_count_properties, except we're only
@@ -105,13 +196,24 @@ gen_waif_propdefs(Object *o)
 	    if (p->propdefs.l[i].name[0] == WAIF_PROP_PREFIX)
 		++cnt;
 
+    /* The name index (if any) is allocated right after the defs;
+     * keep it at most half full.
+     */
+    nslots = 0;
+    if (cnt >= WAIF_INDEX_MIN)
+	for (nslots = 2 * WAIF_INDEX_MIN; nslots < 2 * cnt; nslots *= 2)
+	    ;
+
     wpd = (WaifPropdefs *) mymalloc(sizeof(WaifPropdefs) +
-				    cnt * sizeof(Propdef), M_WAIF_XTRA);
+				    cnt * sizeof(Propdef) +
+				    nslots * sizeof(int), M_WAIF_XTRA);
     /* must free this after to avoid getting the same pointer! */
     free_waif_propdefs(o->waif_propdefs);
 
     wpd->refcount = 1;
     wpd->length = cnt;
+    wpd->index = nslots ? (int *) (wpd->defs + cnt) : NULL;
+    wpd->index_mask = nslots - 1;
     cnt = 0;
     for (p = o; p; p = dbpriv_find_object(p->parent)) {
 	Propdef *pd = p->propdefs.l;
@@ -123,6 +225,7 @@ gen_waif_propdefs(Object *o)
 		++cnt;
 	    }
     }
+    index_waif_propdefs(wpd);
 
     o->waif_propdefs = wpd;
 }
@@ -152,6 +255,7 @@ waif_rename_propdef(Object *o, const char *old, const char *new)
 		free_str(old);
 		wpd->defs[i].name = str_ref(new);
 		wpd->defs[i].hash = str_hash(new);
+		index_waif_propdefs(wpd);
 		return;
 	    }
 	panic("waif_rename_propdef(): missing old propdef?");
@@ -204,10 +308,7 @@ alloc_waif_propvals(Waif *w, int clear)
     Var *p;
 
     cnt = count_waif_propvals(w);
-    if (cnt == 0)
-	return NULL;
-
-    p = (Var *)mymalloc(cnt * sizeof(Var), M_WAIF_XTRA);
+    p = get_propvals(cnt);
     if (clear)
 	while (cnt--)
 	    p[cnt].type = TYPE_CLEAR;
@@ -302,7 +403,7 @@ new_waif(Objid class, Objid owner)
 	panic("new_waif() called with invalid class");
 
     res.type = TYPE_WAIF;
-    res.v.waif = (Waif *) mymalloc(sizeof(Waif), M_WAIF);
+    res.v.waif = alloc_waif();
     res.v.waif->class = class;
     res.v.waif->owner = owner;
     if (!classp->waif_propdefs)
@@ -324,11 +425,23 @@ find_propval_offset(Waif *w, const char *name, int *pidx)
 {
     int i, j, idx;
     int hash = str_hash(name);
+    WaifPropdefs *wpd = w->propdefs;
     struct Propdef *pd;
 
     /* First find the offset into the list of possible properties
      */
-    for (i = 0,pd = w->propdefs->defs; i < w->propdefs->length; ++i, ++pd)
+    if (wpd->index) {
+	unsigned h = (unsigned) hash & wpd->index_mask;
+
+	while ((i = wpd->index[h]) >= 0) {
+	    pd = wpd->defs + i;
+	    if (pd->hash == hash && !mystrcasecmp(pd->name, name))
+		goto found;
+	    h = (h + 1) & wpd->index_mask;
+	}
+	return -2;
+    }
+    for (i = 0, pd = wpd->defs; i < wpd->length; ++i, ++pd)
 	if (pd->hash == hash && !mystrcasecmp(pd->name, name))
 	    goto found;
     return -2;
@@ -378,11 +491,12 @@ alloc_propval_offset(Waif *w, int idx)
 {
     int result = -1;	/* avoid warning */
     Var *newpv, *old, *new;
-    int i;
+    int i, ocnt;
 
     /* assert(idx < N_MAPPABLE_PROPS) */
     if (PROP_MAPPED(w->u.pmap, idx))
 	panic("alloc_propval_offset for already allocated idx");
+    ocnt = count_waif_propvals(w);
     MAP_PROP(w->u.pmap, idx);
 
     newpv = alloc_waif_propvals(w, 0);
@@ -400,8 +514,7 @@ alloc_propval_offset(Waif *w, int idx)
 	}
     for (; i < w->propdefs->length; ++i)
 	*new++ = *old++;
-    if (w->propvals)
-	myfree(w->propvals, M_WAIF_XTRA);
+    release_propvals(w->propvals, ocnt);
     w->propvals = newpv;
     return result;
 }
@@ -417,7 +530,7 @@ update_waif_propdefs(Waif *waif)
     Object *classp = dbpriv_find_object(waif->class);
     Propdef *a, *a_end, *b, *b_end;
     Var *xp, *ov;
-    int i, cnt;
+    int i, cnt, ocnt;
     static Var *xfer;
     static int xfer_sz;
 
@@ -430,10 +543,8 @@ update_waif_propdefs(Waif *waif)
 	waif->propdefs = NULL;
 	for (i = 0; i < cnt; ++i)
 	    free_var(waif->propvals[i]);
-	if (waif->propvals) {
-	    myfree(waif->propvals, M_WAIF_XTRA);
-	    waif->propvals = NULL;
-	}
+	release_propvals(waif->propvals, cnt);
+	waif->propvals = NULL;
 	return;
     }
 
@@ -455,6 +566,7 @@ update_waif_propdefs(Waif *waif)
     }
 
     old = waif->propdefs;
+    ocnt = count_waif_propvals(waif);
     waif->propdefs = ref_waif_propdefs(classp->waif_propdefs);
 
     /* If the waif is totally undifferentiated, there's no need for
@@ -569,8 +681,7 @@ update_waif_propdefs(Waif *waif)
 	if (xfer[i].type != TYPE_CLEAR)
 	    MAP_PROP(waif->u.pmap, i);
 
-    if (waif->propvals)
-	myfree(waif->propvals, M_WAIF_XTRA);
+    release_propvals(waif->propvals, ocnt);
     ov = waif->propvals = alloc_waif_propvals(waif, 1);
     for (i = 0; i < cnt && i < N_MAPPABLE_PROPS; ++i)
 	if (xfer[i].type != TYPE_CLEAR)
@@ -593,9 +704,8 @@ free_waif(Waif *waif)
     free_waif_propdefs(waif->propdefs);
     for (i = 0; i < cnt; ++i)
 	free_var(waif->propvals[i]);
-    if (waif->propvals)
-	myfree(waif->propvals, M_WAIF_XTRA);
-    myfree(waif, M_WAIF);
+    release_propvals(waif->propvals, cnt);
+    release_waif(waif);
     --waif_count;
 }
 
@@ -976,7 +1086,7 @@ dbio_read_waif(Var *vp)
      * seemed silly to try and overload new_waif() to do it.
      */
     res.type = TYPE_WAIF;
-    res.v.waif = (Waif *) mymalloc(sizeof(Waif), M_WAIF);
+    res.v.waif = alloc_waif();
     saved_waifs[waif_count++] = w = res.v.waif;
     res.v.waif->propdefs = NULL;
     for (i = 0; i < WAIF_MAPSZ; ++i)
@@ -1006,7 +1116,7 @@ dbio_read_waif(Var *vp)
     size_t size = cnt;
     if (propdefs_length > N_MAPPABLE_PROPS)
 	size += propdefs_length - N_MAPPABLE_PROPS;
-    w->propvals = (Var *)mymalloc(size * sizeof(Var), M_WAIF_XTRA);
+    w->propvals = get_propvals(size);
     for (p = packable, q = w->propvals, i = 0; i < cnt; ++i)
 	*q++ = *p++;
 
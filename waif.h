@@ -192,9 +192,15 @@ struct Waif {
  |  struct WaifPropdefs  |
  *-----------------------*/
 
+/* .index, if non-NULL, is an open-addressed hash table (power-of-two
+ * size, .index_mask+1 slots) mapping name hashes to positions in
+ * .defs[]; it is allocated in the same block, right after .defs[].
+ */
 struct WaifPropdefs {
     int		    refcount;
     int		    length;
+    int		   *index;
+    int		    index_mask;
     struct Propdef  defs[];
 };
 